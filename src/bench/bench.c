@@ -0,0 +1,203 @@
+/**
+ * Copyright (c) 2011 ~ 2012 Deepin, Inc.
+ *               2011 ~ 2012 snyh
+ *
+ * Author:      snyh <snyh@snyh.org>
+ * Maintainer:  snyh <snyh@snyh.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ **/
+#include <sys/stat.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include "dcore/perf_stats.h"
+#include "bench.h"
+
+/*
+ * dde-bench times the desktop's file, thumbnail, pixbuf and signal paths and
+ * the round trips through dentry's generated glue on synthetic desktops in a
+ * temporary HOME and prints the numbers as the JSON of perf_stats_collect,
+ * times in microseconds. Code which needs X is skipped without a display
+ * (run it under Xvfb to get those too). Limits are read from
+ * DDE_PERF_THRESHOLDS like the running desktop does ("[bench]" group), and
+ * the exit code is 1 when one of them is exceeded:
+ *
+ *   dde-bench --sizes=100,1000 > before.json
+ */
+
+static json_object* _results = NULL;
+
+
+void bench_record(const char* key, double value)
+{
+    if (_results == NULL)
+        _results = json_object_new_object();
+    json_object_object_add(_results, key, json_object_new_double(value));
+}
+
+
+void bench_record_us(const char* key, gint64 start)
+{
+    bench_record(key, g_get_monotonic_time() - start);
+}
+
+
+static void _collect_results(json_object* stats)
+{
+    if (_results == NULL)
+        return;
+    json_object_object_foreach(_results, key, value)
+        json_object_object_add(stats, key, json_object_get(value));
+}
+
+
+void bench_clear_dir(const char* path)
+{
+    GDir* dir = g_dir_open(path, 0, NULL);
+    if (dir == NULL)
+        return;
+
+    const char* name = NULL;
+    while ((name = g_dir_read_name(dir)) != NULL) {
+        char* child = g_build_filename(path, name, NULL);
+        GStatBuf st;
+        if (g_lstat(child, &st) == 0 && S_ISDIR(st.st_mode)) {
+            bench_clear_dir(child);
+            g_rmdir(child);
+        } else {
+            g_remove(child);
+        }
+        g_free(child);
+    }
+    g_dir_close(dir);
+}
+
+
+static
+int* _parse_sizes(const char* str)
+{
+    char** parts = g_strsplit(str, ",", -1);
+    int* sizes = g_new0(int, g_strv_length(parts) + 1);
+    int n = 0;
+    for (int i = 0; parts[i] != NULL; ++i) {
+        int size = atoi(parts[i]);
+        if (size > 0)
+            sizes[n++] = size;
+    }
+    g_strfreev(parts);
+    return sizes;
+}
+
+
+/*
+ * Point HOME and the XDG user dirs at @home before anything asks glib for
+ * them, glib caches them on first use.
+ */
+static
+void _setup_home(const char* home)
+{
+    static const struct {
+        const char* env;
+        const char* dir;
+    } dirs[] = {
+        { "XDG_CONFIG_HOME", ".config" },
+        { "XDG_CACHE_HOME", ".cache" },
+        { "XDG_DATA_HOME", ".local/share" },
+        { NULL, "Desktop" },
+    };
+
+    g_setenv("HOME", home, TRUE);
+    for (guint i = 0; i < G_N_ELEMENTS(dirs); ++i) {
+        char* dir = g_build_filename(home, dirs[i].dir, NULL);
+        g_mkdir_with_parents(dir, 0755);
+        if (dirs[i].env != NULL)
+            g_setenv(dirs[i].env, dir, TRUE);
+        g_free(dir);
+    }
+}
+
+
+int main(int argc, char* argv[])
+{
+    char* sizes = NULL;
+    gboolean no_large_images = FALSE;
+    gboolean keep = FALSE;
+    BenchOptions options = { NULL, TRUE, 100000 };
+
+    GOptionEntry entries[] = {
+        { "sizes", 0, 0, G_OPTION_ARG_STRING, &sizes,
+            "the synthetic desktop sizes, default 100,1000,10000", "N,..." },
+        { "no-large-images", 0, 0, G_OPTION_ARG_NONE, &no_large_images,
+            "skip scaling down the 12 and 50 MP images", NULL },
+        { "signals", 0, 0, G_OPTION_ARG_INT, &options.signals,
+            "posts per signal shape and path, default 100000", "N" },
+        { "keep", 0, 0, G_OPTION_ARG_NONE, &keep,
+            "keep the temporary HOME", NULL },
+        { NULL, 0, 0, 0, NULL, NULL, NULL }
+    };
+
+    GError* error = NULL;
+    GOptionContext* context = g_option_context_new("- time the desktop's hot paths");
+    g_option_context_add_main_entries(context, entries, NULL);
+    if (!g_option_context_parse(context, &argc, &argv, &error)) {
+        fprintf(stderr, "%s\n", error->message);
+        g_error_free(error);
+        g_option_context_free(context);
+        return 2;
+    }
+    g_option_context_free(context);
+
+    options.desktop_sizes = _parse_sizes(sizes != NULL ? sizes : "100,1000,10000");
+    options.large_images = !no_large_images;
+    g_free(sizes);
+
+    char* home = g_dir_make_tmp("dde-bench-XXXXXX", &error);
+    if (home == NULL) {
+        fprintf(stderr, "%s\n", error->message);
+        g_error_free(error);
+        return 2;
+    }
+    _setup_home(home);
+
+    perf_stats_register("bench", _collect_results);
+
+    bench_run_desktop(&options);
+    bench_run_images(&options);
+    bench_run_category(&options);
+    bench_run_signals(&options);
+    bench_run_rpc(&options);
+
+    json_object* stats = perf_stats_collect();
+    json_object* regressions = NULL;
+    json_object_object_get_ex(stats, "regressions", &regressions);
+    int ret = json_object_array_length(regressions) == 0 ? 0 : 1;
+    printf("%s\n", json_object_to_json_string(stats));
+    json_object_put(stats);
+    perf_stats_dump();
+
+    if (keep) {
+        fprintf(stderr, "the synthetic HOME is kept in %s\n", home);
+    } else {
+        bench_clear_dir(home);
+        g_rmdir(home);
+    }
+    g_free(home);
+    g_free(options.desktop_sizes);
+
+    return ret;
+}
@@ -0,0 +1,53 @@
+/**
+ * Copyright (c) 2011 ~ 2012 Deepin, Inc.
+ *               2011 ~ 2012 snyh
+ *
+ * Author:      snyh <snyh@snyh.org>
+ * Maintainer:  snyh <snyh@snyh.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ **/
+#ifndef _BENCH_H_
+#define _BENCH_H_
+
+#include <glib.h>
+
+typedef struct _BenchOptions {
+    int* desktop_sizes; // 0 terminated
+    gboolean large_images; // the 12 and 50 MP scale downs
+    int signals; // posts per signal shape and path
+} BenchOptions;
+
+// add "<key>": value to the "bench" group of the results.
+void bench_record(const char* key, double value);
+void bench_record_us(const char* key, gint64 start); // now - start
+
+// the synthetic desktop of bench_run_desktop, under $HOME/Desktop.
+void bench_make_desktop(int size);
+void bench_clear_dir(const char* path);
+
+void bench_run_desktop(const BenchOptions* options);
+void bench_run_images(const BenchOptions* options);
+void bench_run_category(const BenchOptions* options);
+void bench_run_signals(const BenchOptions* options);
+void bench_run_rpc(const BenchOptions* options);
+
+// the fake crosswalk of bench_xwalk.c, which initializes dentry's generated
+// glue. Posted messages only add up their size.
+extern gsize bench_posted_bytes;
+void bench_xwalk_init();
+// the reply of handle_sync_message to @msg, valid until the next call.
+const char* bench_sync_call(const char* msg);
+
+#endif
@@ -0,0 +1,62 @@
+/**
+ * Copyright (c) 2011 ~ 2012 Deepin, Inc.
+ *               2011 ~ 2012 snyh
+ *
+ * Author:      snyh <snyh@snyh.org>
+ * Maintainer:  snyh <snyh@snyh.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ **/
+#include <glib.h>
+
+#include "common/category.h"
+#include "bench.h"
+
+#define CATEGORY_LOOKUPS 1000
+
+/*
+ * The category map comes from the software center databases, so this only
+ * runs where they are installed. The cold lookup finds no snapshot in the
+ * bench's HOME and reads the database.
+ */
+void bench_run_category(const BenchOptions* options G_GNUC_UNUSED)
+{
+    gint64 start = g_get_monotonic_time();
+    GHashTable* map = get_category_map();
+    gint64 cold = g_get_monotonic_time() - start;
+
+    if (map == NULL || g_hash_table_size(map) == 0) {
+        g_message("[%s] no category database, skip", __func__);
+        return;
+    }
+    bench_record("category_map_cold_us", cold);
+    bench_record("category_map_items", g_hash_table_size(map));
+    bench_record("category_map_bytes", category_map_memory_size());
+
+    start = g_get_monotonic_time();
+    for (int i = 0; i < CATEGORY_LOOKUPS; ++i)
+        get_category_map();
+    bench_record("category_map_cached_us", (double)(g_get_monotonic_time() - start) / CATEGORY_LOOKUPS);
+
+    char* path = g_build_filename(g_get_user_cache_dir(), "bench-category.snapshot", NULL);
+    start = g_get_monotonic_time();
+    if (category_map_save_snapshot(path)) {
+        bench_record_us("category_snapshot_save_us", start);
+
+        start = g_get_monotonic_time();
+        if (category_map_load_snapshot(path))
+            bench_record_us("category_snapshot_load_us", start);
+    }
+    g_free(path);
+}
@@ -0,0 +1,291 @@
+/**
+ * Copyright (c) 2011 ~ 2012 Deepin, Inc.
+ *               2011 ~ 2012 snyh
+ *
+ * Author:      snyh <snyh@snyh.org>
+ * Maintainer:  snyh <snyh@snyh.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ **/
+#include <string.h>
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <gio/gio.h>
+#include <gdk-pixbuf/gdk-pixbuf.h>
+
+#include "common/xdg_misc.h"
+#include "common/utils.h"
+#include "common/pixbuf.h"
+#include "dentry/content_type_cache.h"
+#include "dentry/desktop_names.h"
+#include "bench.h"
+
+#define LOOKUPS 10000
+#define FREE_CHILDREN 100
+#define DATA_URIS 100
+#define DIRECTORY_ICONS 100
+#define RICHDIR_BACKGROUND "/usr/share/dde/resources/desktop/img/richdir_background.png"
+
+/*
+ * The files of a synthetic desktop, in rotation. Contents are just enough
+ * for the content type sniffing to look at them like real files.
+ */
+static const struct {
+    const char* name;
+    const char* content;
+} plain_files[] = {
+    { "notes-%d.txt", "some notes\n" },
+    { "main-%d.c", "#include <stdio.h>\nint main() { return 0; }\n" },
+    { "run-%d.sh", "#!/bin/sh\necho hello\n" },
+    { "report-%d.pdf", "%PDF-1.4\n%\xe2\xe3\xcf\xd3\n" },
+    { "archive-%d.zip", "PK\x03\x04\x14\x00\x00\x00" },
+    { "README-%d", "no extension, sniffed as text\n" },
+    { "data-%d.bin", "\x7f\x45\x4c\x46\x02\x01\x01" },
+};
+
+static GBytes* _png = NULL;
+static GBytes* _jpeg = NULL;
+
+
+static
+GBytes* _encode_image(const char* type, int width, int height)
+{
+    GdkPixbuf* pixbuf = gdk_pixbuf_new(GDK_COLORSPACE_RGB, FALSE, 8, width, height);
+    gdk_pixbuf_fill(pixbuf, 0x3c78b4ff);
+
+    gchar* buf = NULL;
+    gsize size = 0;
+    gdk_pixbuf_save_to_buffer(pixbuf, &buf, &size, type, NULL, NULL);
+    g_object_unref(pixbuf);
+
+    return g_bytes_new_take(buf, size);
+}
+
+
+static
+void _encode_images()
+{
+    if (_png == NULL) {
+        _png = _encode_image("png", 64, 64);
+        _jpeg = _encode_image("jpeg", 64, 48);
+    }
+}
+
+
+static
+void _write_file(const char* dir, const char* name, gconstpointer data, gsize len)
+{
+    char* path = g_build_filename(dir, name, NULL);
+    g_file_set_contents(path, data, len, NULL);
+    g_free(path);
+}
+
+
+static
+void _write_desktop_file(const char* dir, const char* name, int i)
+{
+    char* content = g_strdup_printf("[Desktop Entry]\nType=Application\nName=App %d\n"
+                                    "Exec=true %%U\nIcon=application-x-executable\n", i);
+    _write_file(dir, name, content, strlen(content));
+    g_free(content);
+}
+
+
+/*
+ * Every 20 entries: a directory, a rich dir, two .desktop files, a PNG, a
+ * JPEG and plain files. A few "Untitled Folder(N)" names are taken, like on
+ * a desktop where new folders were made before.
+ */
+void bench_make_desktop(int size)
+{
+    const char* desktop = DESKTOP_DIR();
+    bench_clear_dir(desktop);
+    _encode_images();
+
+    for (int i = 0; i < size; ++i) {
+        char* name = NULL;
+        char* path = NULL;
+        switch (i % 20) {
+        case 0:
+            name = g_strdup_printf("Folder %d", i);
+            path = g_build_filename(desktop, name, NULL);
+            g_mkdir(path, 0755);
+            _write_file(path, "inside.txt", "x\n", 2);
+            g_free(path);
+            break;
+        case 1:
+            name = g_strdup_printf(DEEPIN_RICH_DIR "Apps %d", i);
+            path = g_build_filename(desktop, name, NULL);
+            g_mkdir(path, 0755);
+            _write_desktop_file(path, "first.desktop", i);
+            _write_desktop_file(path, "second.desktop", i);
+            g_free(path);
+            break;
+        case 2:
+        case 3:
+            name = g_strdup_printf("app-%d.desktop", i);
+            _write_desktop_file(desktop, name, i);
+            break;
+        case 4:
+            name = g_strdup_printf("picture-%d.png", i);
+            _write_file(desktop, name, g_bytes_get_data(_png, NULL), g_bytes_get_size(_png));
+            break;
+        case 5:
+            name = g_strdup_printf("photo-%d.jpg", i);
+            _write_file(desktop, name, g_bytes_get_data(_jpeg, NULL), g_bytes_get_size(_jpeg));
+            break;
+        default: {
+            guint k = i % G_N_ELEMENTS(plain_files);
+            name = g_strdup_printf(plain_files[k].name, i);
+            _write_file(desktop, name, plain_files[k].content, strlen(plain_files[k].content));
+        }
+        }
+        g_free(name);
+    }
+
+    for (int i = -1; i < 10 && i < size / 100; ++i) {
+        char* name = i < 0 ? g_strdup("Untitled Folder") : g_strdup_printf("Untitled Folder(%d)", i);
+        char* path = g_build_filename(desktop, name, NULL);
+        g_mkdir(path, 0755);
+        g_free(path);
+        g_free(name);
+    }
+}
+
+
+static
+GPtrArray* _list_desktop()
+{
+    GPtrArray* files = g_ptr_array_new_with_free_func(g_object_unref);
+    GDir* dir = g_dir_open(DESKTOP_DIR(), 0, NULL);
+    const char* name = NULL;
+    while (dir != NULL && (name = g_dir_read_name(dir)) != NULL) {
+        char* path = g_build_filename(DESKTOP_DIR(), name, NULL);
+        g_ptr_array_add(files, g_file_new_for_path(path));
+        g_free(path);
+    }
+    if (dir != NULL)
+        g_dir_close(dir);
+    return files;
+}
+
+
+static
+void _bench_content_types(int size)
+{
+    GPtrArray* files = _list_desktop();
+    char* key = NULL;
+
+    content_type_cache_clear();
+    for (int pass = 0; pass < 2; ++pass) {
+        gint64 start = g_get_monotonic_time();
+        for (guint i = 0; i < files->len; ++i) {
+            FileTypeInfo info;
+            gfile_query_type_info(files->pdata[i], G_FILE_QUERY_INFO_NONE, &info);
+        }
+        key = g_strdup_printf("content_type_%d_%s_us", size, pass == 0 ? "cold" : "cached");
+        bench_record_us(key, start);
+        g_free(key);
+    }
+
+    g_ptr_array_unref(files);
+}
+
+
+static
+void _bench_desktop_names(int size)
+{
+    GFile* desktop = g_file_new_for_path(DESKTOP_DIR());
+    char* key = NULL;
+
+    // what the desktop does: one read, then the watcher keeps the set.
+    desktop_names_set_watched(TRUE);
+    gint64 start = g_get_monotonic_time();
+    desktop_names_contains("Folder 0");
+    key = g_strdup_printf("desktop_names_%d_load_us", size);
+    bench_record_us(key, start);
+    g_free(key);
+
+    start = g_get_monotonic_time();
+    for (int i = 0; i < LOOKUPS; ++i) {
+        char name[32];
+        g_snprintf(name, sizeof(name), "notes-%d.txt", i);
+        desktop_names_contains(name);
+    }
+    key = g_strdup_printf("desktop_names_%d_lookup_us", size);
+    bench_record(key, (double)(g_get_monotonic_time() - start) / LOOKUPS);
+    g_free(key);
+
+    start = g_get_monotonic_time();
+    for (int i = 0; i < FREE_CHILDREN; ++i)
+        g_object_unref(desktop_names_get_free_child(desktop, "Untitled Folder", "Untitled Folder", ""));
+    key = g_strdup_printf("desktop_names_%d_free_child_us", size);
+    bench_record(key, (double)(g_get_monotonic_time() - start) / FREE_CHILDREN);
+    g_free(key);
+
+    // without the watcher every query reads the directory again.
+    desktop_names_set_watched(FALSE);
+    start = g_get_monotonic_time();
+    for (int i = 0; i < 10; ++i)
+        g_object_unref(desktop_names_get_free_child(desktop, "Untitled Folder", "Untitled Folder", ""));
+    key = g_strdup_printf("desktop_names_%d_unwatched_free_child_us", size);
+    bench_record(key, (double)(g_get_monotonic_time() - start) / 10);
+    g_free(key);
+
+    g_object_unref(desktop);
+}
+
+
+static
+void _bench_pixbuf_helpers()
+{
+    GdkPixbuf* pixbuf = gdk_pixbuf_new(GDK_COLORSPACE_RGB, TRUE, 8, 128, 128);
+    gdk_pixbuf_fill(pixbuf, 0x3c78b4ff);
+
+    gint64 start = g_get_monotonic_time();
+    for (int i = 0; i < DATA_URIS; ++i)
+        g_free(get_data_uri_by_pixbuf(pixbuf));
+    bench_record("data_uri_128_us", (double)(g_get_monotonic_time() - start) / DATA_URIS);
+    g_object_unref(pixbuf);
+
+    // the rich dir icon needs the installed background.
+    if (!g_file_test(RICHDIR_BACKGROUND, G_FILE_TEST_EXISTS))
+        return;
+
+    _encode_images();
+    char* icon = g_build_filename(g_get_user_cache_dir(), "bench-icon.png", NULL);
+    g_file_set_contents(icon, g_bytes_get_data(_png, NULL), g_bytes_get_size(_png), NULL);
+    start = g_get_monotonic_time();
+    for (int i = 0; i < DIRECTORY_ICONS; ++i)
+        g_free(generate_directory_icon(icon, icon, icon, icon));
+    bench_record("directory_icon_us", (double)(g_get_monotonic_time() - start) / DIRECTORY_ICONS);
+    g_free(icon);
+}
+
+
+void bench_run_desktop(const BenchOptions* options)
+{
+    for (int* size = options->desktop_sizes; *size != 0; ++size) {
+        gint64 start = g_get_monotonic_time();
+        bench_make_desktop(*size);
+        g_debug("[%s] made a desktop of %d in %" G_GINT64_FORMAT "us",
+                __func__, *size, g_get_monotonic_time() - start);
+
+        _bench_content_types(*size);
+        _bench_desktop_names(*size);
+    }
+
+    _bench_pixbuf_helpers();
+}
@@ -0,0 +1,287 @@
+/**
+ * Copyright (c) 2011 ~ 2012 Deepin, Inc.
+ *               2011 ~ 2012 snyh
+ *
+ * Author:      snyh <snyh@snyh.org>
+ * Maintainer:  snyh <snyh@snyh.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ **/
+#include <sys/stat.h>
+#include <string.h>
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <gio/gio.h>
+#include <gdk-pixbuf/gdk-pixbuf.h>
+
+#include "dentry/gnome-desktop-thumbnail.h"
+#include "bench.h"
+
+#define THUMBNAIL_SIZE 128
+#define PHOTOS 20
+#define PHOTO_WIDTH 2000
+#define PHOTO_HEIGHT 1500
+
+static const struct {
+    const char* key;
+    int width;
+    int height;
+} scale_down_sources[] = {
+    { "scale_down_12mp_us", 4000, 3000 },
+    { "scale_down_50mp_us", 8160, 6120 },
+};
+
+
+static
+GdkPixbuf* _new_photo(int width, int height)
+{
+    GdkPixbuf* pixbuf = gdk_pixbuf_new(GDK_COLORSPACE_RGB, FALSE, 8, width, height);
+    guchar* pixels = gdk_pixbuf_get_pixels(pixbuf);
+    int rowstride = gdk_pixbuf_get_rowstride(pixbuf);
+
+    // gradients, so encoders and scalers don't see a flat image.
+    for (int y = 0; y < height; ++y) {
+        guchar* p = pixels + (gsize)y * rowstride;
+        for (int x = 0; x < width; ++x, p += 3) {
+            p[0] = x * 255 / width;
+            p[1] = y * 255 / height;
+            p[2] = (x ^ y) & 0xff;
+        }
+    }
+    return pixbuf;
+}
+
+
+static
+void _bench_scale_down(const BenchOptions* options)
+{
+    for (guint i = 0; i < G_N_ELEMENTS(scale_down_sources); ++i) {
+        if (!options->large_images)
+            break;
+
+        int width = scale_down_sources[i].width;
+        int height = scale_down_sources[i].height;
+        GdkPixbuf* source = _new_photo(width, height);
+
+        // the best of three, the first run also pays for faulting the pages.
+        gint64 best = G_MAXINT64;
+        for (int run = 0; run < 3; ++run) {
+            gint64 start = g_get_monotonic_time();
+            GdkPixbuf* thumb = gnome_desktop_thumbnail_scale_down_pixbuf(source, THUMBNAIL_SIZE,
+                                                                         THUMBNAIL_SIZE * height / width);
+            best = MIN(best, g_get_monotonic_time() - start);
+            g_object_unref(thumb);
+        }
+        bench_record(scale_down_sources[i].key, best);
+        g_object_unref(source);
+    }
+}
+
+
+static
+void _put16(guchar* p, guint16 v)
+{
+    p[0] = v & 0xff;
+    p[1] = v >> 8;
+}
+
+
+static
+void _put32(guchar* p, guint32 v)
+{
+    _put16(p, v & 0xffff);
+    _put16(p + 2, v >> 16);
+}
+
+
+/*
+ * @jpeg with an Exif APP1 segment holding @thumb in IFD1, the way cameras
+ * write it: little endian TIFF, IFD0 with the orientation, IFD1 with the
+ * JPEGInterchangeFormat offset and length.
+ */
+static
+GBytes* _add_exif_thumbnail(GBytes* jpeg, GBytes* thumb)
+{
+    gsize jpeg_len = 0, thumb_len = 0;
+    const guchar* jpeg_data = g_bytes_get_data(jpeg, &jpeg_len);
+    const guchar* thumb_data = g_bytes_get_data(thumb, &thumb_len);
+
+    // TIFF header (8), IFD0 with one entry (18), IFD1 with two (30)
+    const gsize tiff_head = 8 + 18 + 30;
+    gsize seg_len = 2 + 6 + tiff_head + thumb_len;
+    g_assert(seg_len <= 0xffff);
+
+    guchar* out = g_malloc0(2 + 2 + seg_len + jpeg_len - 2);
+    guchar* p = out;
+    *p++ = 0xff; *p++ = 0xd8;
+    *p++ = 0xff; *p++ = 0xe1;
+    *p++ = seg_len >> 8; *p++ = seg_len & 0xff;
+    memcpy(p, "Exif\0\0", 6);
+    p += 6;
+
+    guchar* tiff = p;
+    memcpy(tiff, "II", 2);
+    _put16(tiff + 2, 42);
+    _put32(tiff + 4, 8);
+
+    _put16(tiff + 8, 1);
+    _put16(tiff + 10, 0x0112); // orientation, SHORT, 1
+    _put16(tiff + 12, 3);
+    _put32(tiff + 14, 1);
+    _put16(tiff + 18, 1);
+    _put32(tiff + 22, 26); // next IFD
+
+    _put16(tiff + 26, 2);
+    _put16(tiff + 28, 0x0201); // JPEGInterchangeFormat, LONG
+    _put16(tiff + 30, 4);
+    _put32(tiff + 32, 1);
+    _put32(tiff + 36, tiff_head);
+    _put16(tiff + 40, 0x0202); // JPEGInterchangeFormatLength, LONG
+    _put16(tiff + 42, 4);
+    _put32(tiff + 44, 1);
+    _put32(tiff + 48, thumb_len);
+    _put32(tiff + 52, 0);
+
+    memcpy(tiff + tiff_head, thumb_data, thumb_len);
+    p = tiff + tiff_head + thumb_len;
+
+    // the photo without its SOI
+    memcpy(p, jpeg_data + 2, jpeg_len - 2);
+    p += jpeg_len - 2;
+
+    return g_bytes_new_take(out, p - out);
+}
+
+
+static
+GBytes* _encode_jpeg(int width, int height)
+{
+    GdkPixbuf* pixbuf = _new_photo(width, height);
+    gchar* buf = NULL;
+    gsize size = 0;
+    gdk_pixbuf_save_to_buffer(pixbuf, &buf, &size, "jpeg", NULL, "quality", "90", NULL);
+    g_object_unref(pixbuf);
+    return g_bytes_new_take(buf, size);
+}
+
+
+static
+char** _write_photos(const char* dir, const char* prefix, GBytes* content)
+{
+    char** uris = g_new0(char*, PHOTOS + 1);
+    for (int i = 0; i < PHOTOS; ++i) {
+        char* name = g_strdup_printf("%s-%d.jpg", prefix, i);
+        char* path = g_build_filename(dir, name, NULL);
+        g_file_set_contents(path, g_bytes_get_data(content, NULL), g_bytes_get_size(content), NULL);
+        uris[i] = g_filename_to_uri(path, NULL, NULL);
+        g_free(path);
+        g_free(name);
+    }
+    return uris;
+}
+
+
+static
+time_t _get_mtime(const char* uri)
+{
+    char* path = g_filename_from_uri(uri, NULL, NULL);
+    GStatBuf st;
+    time_t mtime = g_stat(path, &st) == 0 ? st.st_mtime : 0;
+    g_free(path);
+    return mtime;
+}
+
+
+/*
+ * What the desktop does for a photo: can_thumbnail, generate and save it,
+ * then look the saved one up on the next start.
+ */
+static
+void _bench_thumbnail_photos(GnomeDesktopThumbnailFactory* factory, char** uris, const char* name)
+{
+    time_t mtimes[PHOTOS];
+    for (int i = 0; i < PHOTOS; ++i)
+        mtimes[i] = _get_mtime(uris[i]);
+
+    gint64 start = g_get_monotonic_time();
+    for (int i = 0; i < PHOTOS; ++i)
+        gnome_desktop_thumbnail_factory_can_thumbnail(factory, uris[i], "image/jpeg", mtimes[i]);
+    char* key = g_strdup_printf("thumbnail_%s_can_thumbnail_us", name);
+    bench_record(key, (double)(g_get_monotonic_time() - start) / PHOTOS);
+    g_free(key);
+
+    start = g_get_monotonic_time();
+    for (int i = 0; i < PHOTOS; ++i) {
+        GdkPixbuf* thumb = gnome_desktop_thumbnail_factory_generate_thumbnail(factory, uris[i], "image/jpeg");
+        if (thumb != NULL) {
+            gnome_desktop_thumbnail_factory_save_thumbnail(factory, thumb, uris[i], mtimes[i]);
+            g_object_unref(thumb);
+        }
+    }
+    key = g_strdup_printf("thumbnail_%s_generate_us", name);
+    bench_record(key, (double)(g_get_monotonic_time() - start) / PHOTOS);
+    g_free(key);
+
+    start = g_get_monotonic_time();
+    for (int i = 0; i < PHOTOS; ++i)
+        g_free(gnome_desktop_thumbnail_factory_lookup(factory, uris[i], mtimes[i]));
+    key = g_strdup_printf("thumbnail_%s_lookup_us", name);
+    bench_record(key, (double)(g_get_monotonic_time() - start) / PHOTOS);
+    g_free(key);
+}
+
+
+static
+void _bench_thumbnails()
+{
+    // the factory aborts without its settings schema.
+    GSettingsSchemaSource* source = g_settings_schema_source_get_default();
+    GSettingsSchema* schema = source != NULL ?
+        g_settings_schema_source_lookup(source, "org.gnome.desktop.thumbnailers", TRUE) : NULL;
+    if (schema == NULL) {
+        g_message("[%s] org.gnome.desktop.thumbnailers isn't installed, skip", __func__);
+        return;
+    }
+    g_settings_schema_unref(schema);
+
+    char* dir = g_build_filename(g_get_user_cache_dir(), "bench-photos", NULL);
+    g_mkdir_with_parents(dir, 0755);
+
+    GBytes* photo = _encode_jpeg(PHOTO_WIDTH, PHOTO_HEIGHT);
+    GBytes* thumb = _encode_jpeg(160, 120);
+    GBytes* exif_photo = _add_exif_thumbnail(photo, thumb);
+
+    char** plain = _write_photos(dir, "plain", photo);
+    char** exif = _write_photos(dir, "exif", exif_photo);
+
+    GnomeDesktopThumbnailFactory* factory = gnome_desktop_thumbnail_factory_new(GNOME_DESKTOP_THUMBNAIL_SIZE_NORMAL);
+    _bench_thumbnail_photos(factory, plain, "jpeg");
+    _bench_thumbnail_photos(factory, exif, "exif_jpeg");
+    g_object_unref(factory);
+
+    g_strfreev(plain);
+    g_strfreev(exif);
+    g_bytes_unref(exif_photo);
+    g_bytes_unref(thumb);
+    g_bytes_unref(photo);
+    g_free(dir);
+}
+
+
+void bench_run_images(const BenchOptions* options)
+{
+    _bench_scale_down(options);
+    _bench_thumbnails();
+}
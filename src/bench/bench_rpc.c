@@ -0,0 +1,208 @@
+/**
+ * Copyright (c) 2011 ~ 2012 Deepin, Inc.
+ *               2011 ~ 2012 snyh
+ *
+ * Author:      snyh <snyh@snyh.org>
+ * Maintainer:  snyh <snyh@snyh.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ **/
+#include <glib.h>
+#include <gdk/gdk.h>
+
+#include "json-c/json.h"
+#include "common/config.h"
+#include "common/xdg_misc.h"
+#include "bench.h"
+
+/*
+ * Round trips through the generated dentry glue: the JSON message JS sends
+ * goes to handle_sync_message, which parses it, calls the real dentry_*
+ * function and serializes the reply. Every command runs once per entry of a
+ * synthetic desktop of RPC_DESKTOP_SIZE, the average is recorded as
+ * "rpc_<cmd>_us". The desktop module's own functions are called directly,
+ * its glue can't be linked next to dentry's.
+ */
+#define RPC_DESKTOP_SIZE 1000
+#define EXIST_LOOKUPS 10000
+
+// desktop.c, the desktop module has no header for them.
+ArrayContainer desktop_get_desktop_entries();
+gboolean desktop_file_exist_in_desktop(char* name);
+
+static const char* entry_commands[] = {
+    "get_type",
+    "get_flags",
+    "get_id",
+    "get_name",
+    "get_mtime",
+    "get_uri",
+    "can_thumbnail",
+};
+
+// the icon theme needs a screen.
+static const char* display_commands[] = {
+    "get_icon",
+};
+
+
+static
+gint64 _call(const char* msg)
+{
+    json_object* reply = json_tokener_parse(bench_sync_call(msg));
+    json_object* data = NULL;
+    gint64 value = 0;
+    if (reply != NULL && json_object_object_get_ex(reply, "data", &data))
+        value = json_object_get_int64(data);
+    json_object_put(reply);
+    return value;
+}
+
+
+static
+char* _message(const char* cmd, json_object* args)
+{
+    json_object* msg = json_object_new_object();
+    json_object_object_add(msg, "cmd", json_object_new_string(cmd));
+    json_object_object_add(msg, "args", args);
+    char* str = g_strdup(json_object_to_json_string(msg));
+    json_object_put(msg);
+    return str;
+}
+
+
+static
+GArray* _create_entries()
+{
+    GArray* handles = g_array_new(FALSE, FALSE, sizeof(gint64));
+    GDir* dir = g_dir_open(DESKTOP_DIR(), 0, NULL);
+    const char* name = NULL;
+    gint64 elapsed = 0;
+    while (dir != NULL && (name = g_dir_read_name(dir)) != NULL) {
+        json_object* args = json_object_new_array();
+        char* path = g_build_filename(DESKTOP_DIR(), name, NULL);
+        json_object_array_add(args, json_object_new_string(path));
+        g_free(path);
+        char* msg = _message("create_by_path", args);
+
+        gint64 start = g_get_monotonic_time();
+        gint64 handle = _call(msg);
+        elapsed += g_get_monotonic_time() - start;
+
+        g_array_append_val(handles, handle);
+        g_free(msg);
+    }
+    if (dir != NULL)
+        g_dir_close(dir);
+
+    if (handles->len != 0)
+        bench_record("rpc_create_by_path_us", (double)elapsed / handles->len);
+    return handles;
+}
+
+
+static
+void _bench_entry_command(const char* cmd, GArray* handles)
+{
+    gint64 elapsed = 0;
+    for (guint i = 0; i < handles->len; ++i) {
+        char* msg = g_strdup_printf("{\"cmd\": \"%s\", \"args\": [%" G_GINT64_FORMAT "]}",
+                                    cmd, g_array_index(handles, gint64, i));
+        gint64 start = g_get_monotonic_time();
+        _call(msg);
+        elapsed += g_get_monotonic_time() - start;
+        g_free(msg);
+    }
+
+    char* key = g_strdup_printf("rpc_%s_us", cmd);
+    bench_record(key, (double)elapsed / handles->len);
+    g_free(key);
+}
+
+
+static
+void _bench_selection(GArray* handles)
+{
+    json_object* selection = json_object_new_array();
+    for (guint i = 0; i < handles->len; ++i)
+        json_object_array_add(selection, json_object_new_int64(g_array_index(handles, gint64, i)));
+    json_object* args = json_object_new_array();
+    json_object_array_add(args, selection);
+    char* msg = _message("get_selection_capabilities", args);
+
+    gint64 start = g_get_monotonic_time();
+    _call(msg);
+    bench_record_us("rpc_get_selection_capabilities_us", start);
+    g_free(msg);
+}
+
+
+/*
+ * What the desktop does on start: list the entries, then JS releases the
+ * ones it replaces.
+ */
+static
+void _bench_desktop_entries()
+{
+    gint64 start = g_get_monotonic_time();
+    ArrayContainer entries = desktop_get_desktop_entries();
+    bench_record_us("desktop_get_desktop_entries_us", start);
+
+    start = g_get_monotonic_time();
+    for (int i = 0; i < EXIST_LOOKUPS; ++i) {
+        char name[32];
+        g_snprintf(name, sizeof(name), "notes-%d.txt", i);
+        desktop_file_exist_in_desktop(name);
+    }
+    bench_record("desktop_file_exist_in_desktop_us",
+                 (double)(g_get_monotonic_time() - start) / EXIST_LOOKUPS);
+
+    start = g_get_monotonic_time();
+    for (size_t i = 0; i < entries.num; ++i) {
+        char* msg = g_strdup_printf("{\"cmd\": \"release\", \"args\": [%" G_GINT64_FORMAT "]}",
+                                    (gint64)((void**)entries.data)[i]);
+        _call(msg);
+        g_free(msg);
+    }
+    if (entries.num != 0)
+        bench_record("rpc_release_us", (double)(g_get_monotonic_time() - start) / entries.num);
+    g_free(entries.data);
+}
+
+
+void bench_run_rpc(const BenchOptions* options G_GNUC_UNUSED)
+{
+    bench_make_desktop(RPC_DESKTOP_SIZE);
+    bench_xwalk_init();
+
+    GArray* handles = _create_entries();
+    if (handles->len == 0) {
+        g_array_free(handles, TRUE);
+        return;
+    }
+
+    for (guint i = 0; i < G_N_ELEMENTS(entry_commands); ++i)
+        _bench_entry_command(entry_commands[i], handles);
+    _bench_selection(handles);
+
+    if (gdk_display_get_default() != NULL) {
+        for (guint i = 0; i < G_N_ELEMENTS(display_commands); ++i)
+            _bench_entry_command(display_commands[i], handles);
+    } else {
+        g_message("[%s] no display, skip %s", __func__, display_commands[0]);
+    }
+
+    _bench_desktop_entries();
+    g_array_free(handles, TRUE);
+}
@@ -0,0 +1,120 @@
+/**
+ * Copyright (c) 2011 ~ 2012 Deepin, Inc.
+ *               2011 ~ 2012 snyh
+ *
+ * Author:      snyh <snyh@snyh.org>
+ * Maintainer:  snyh <snyh@snyh.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ **/
+#include <glib.h>
+
+#include "json-c/json.h"
+#include "common/config.h"
+#include "dcore/signal.h"
+#include "bench.h"
+
+/*
+ * The ways a signal has been posted, for the two shapes the desktop posts
+ * most: {"value": count} for trash_count_changed and {"entry": handle} for
+ * item_update.
+ *
+ *   json_object   build a json_object and serialize it with js_post_message
+ *   format_parse  the old js_post_message_simply: printf the JSON, parse it
+ *                 back, then go through js_post_message
+ *   builder       js_signal_begin/js_signal_add_*/js_signal_end
+ *
+ * Messages go to a fake instance of bench_xwalk.c, and the queue is flushed
+ * every SIGNAL_FLUSH_EVERY posts the way the main loop would.
+ */
+#define SIGNAL_FLUSH_EVERY 256
+#define BENCH_INSTANCE 1
+
+typedef enum {
+    POST_JSON_OBJECT,
+    POST_FORMAT_PARSE,
+    POST_BUILDER,
+    POST_N,
+} PostPath;
+
+static const char* path_names[POST_N] = { "json_object", "format_parse", "builder" };
+
+static const struct {
+    const char* signal;
+    const char* key;
+    gint64 first_value; // entries are handles, as wide as a pointer
+} shapes[] = {
+    { "trash_count_changed", "value", 0 },
+    { "item_update", "entry", G_GINT64_CONSTANT(0x7f0000000000) },
+};
+
+static
+void _post(PostPath path, const char* signal, const char* key, gint64 value)
+{
+    switch (path) {
+    case POST_JSON_OBJECT: {
+        json_object* json = json_object_new_object();
+        json_object_object_add(json, key, json_object_new_int64(value));
+        js_post_message(signal, json);
+        break;
+    }
+    case POST_FORMAT_PARSE: {
+        char* str = g_strdup_printf("{\"%s\": %" G_GINT64_FORMAT "}", key, value);
+        js_post_message(signal, json_tokener_parse(str));
+        g_free(str);
+        break;
+    }
+    case POST_BUILDER:
+        js_signal_begin(signal);
+        js_signal_add_int(key, value);
+        js_signal_end();
+        break;
+    default:
+        g_assert_not_reached();
+    }
+}
+
+
+void bench_run_signals(const BenchOptions* options)
+{
+    if (options->signals <= 0)
+        return;
+
+    bench_xwalk_init();
+
+    JSCallback callback = { BENCH_INSTANCE };
+    for (guint i = 0; i < G_N_ELEMENTS(shapes); ++i)
+        dcore_signal_connect(shapes[i].signal, &callback);
+
+    for (guint i = 0; i < G_N_ELEMENTS(shapes); ++i) {
+        for (int path = 0; path < POST_N; ++path) {
+            bench_posted_bytes = 0;
+            gint64 start = g_get_monotonic_time();
+            for (int n = 0; n < options->signals; ++n) {
+                _post(path, shapes[i].signal, shapes[i].key, shapes[i].first_value + n);
+                if (n % SIGNAL_FLUSH_EVERY == SIGNAL_FLUSH_EVERY - 1)
+                    while (g_main_context_iteration(NULL, FALSE));
+            }
+            while (g_main_context_iteration(NULL, FALSE));
+
+            char* key = g_strdup_printf("signal_%s_%s_us", shapes[i].signal, path_names[path]);
+            bench_record(key, (double)(g_get_monotonic_time() - start) / options->signals);
+            g_free(key);
+            g_debug("[%s] %s %s posted %" G_GSIZE_FORMAT " bytes", __func__,
+                    shapes[i].signal, path_names[path], bench_posted_bytes);
+        }
+    }
+
+    dcore_signal_instance_destroyed(BENCH_INSTANCE);
+}
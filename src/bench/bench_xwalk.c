@@ -0,0 +1,136 @@
+/**
+ * Copyright (c) 2011 ~ 2012 Deepin, Inc.
+ *               2011 ~ 2012 snyh
+ *
+ * Author:      snyh <snyh@snyh.org>
+ * Maintainer:  snyh <snyh@snyh.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ **/
+#include <string.h>
+
+#include <glib.h>
+
+#include "XW_Extension.h"
+#include "XW_Extension_SyncMessage.h"
+#include "bench.h"
+
+/*
+ * The part of crosswalk the generated dentry glue talks to. The glue is
+ * initialized through its XW_Initialize like the runtime does it, posted
+ * messages are only counted and the last sync reply is kept for the caller.
+ */
+#define BENCH_EXTENSION 1
+#define BENCH_INSTANCE 1
+
+gsize bench_posted_bytes = 0;
+
+static XW_HandleSyncMessageCallback _handle_sync_message = NULL;
+static char* _reply = NULL;
+
+
+static void _set_extension_name(XW_Extension extension G_GNUC_UNUSED, const char* name G_GNUC_UNUSED)
+{
+}
+
+static void _set_javascript_api(XW_Extension extension G_GNUC_UNUSED, const char* api G_GNUC_UNUSED)
+{
+}
+
+static void _register_instance_callbacks(XW_Extension extension G_GNUC_UNUSED,
+                                         XW_CreatedInstanceCallback created G_GNUC_UNUSED,
+                                         XW_DestroyedInstanceCallback destroyed G_GNUC_UNUSED)
+{
+}
+
+static void _register_shutdown_callback(XW_Extension extension G_GNUC_UNUSED,
+                                        XW_ShutdownCallback shutdown_callback G_GNUC_UNUSED)
+{
+}
+
+static void _set_instance_data(XW_Instance instance G_GNUC_UNUSED, void* data G_GNUC_UNUSED)
+{
+}
+
+static void* _get_instance_data(XW_Instance instance G_GNUC_UNUSED)
+{
+    return NULL;
+}
+
+static const XW_CoreInterface _fake_core = {
+    _set_extension_name,
+    _set_javascript_api,
+    _register_instance_callbacks,
+    _register_shutdown_callback,
+    _set_instance_data,
+    _get_instance_data,
+};
+
+
+static void _register(XW_Extension extension G_GNUC_UNUSED,
+                      XW_HandleMessageCallback handle_message G_GNUC_UNUSED)
+{
+}
+
+static void _post_message(XW_Instance instance G_GNUC_UNUSED, const char* message)
+{
+    bench_posted_bytes += strlen(message);
+}
+
+static const XW_MessagingInterface _fake_messaging = { _register, _post_message };
+
+
+static void _register_sync(XW_Extension extension G_GNUC_UNUSED,
+                           XW_HandleSyncMessageCallback handle_sync_message)
+{
+    _handle_sync_message = handle_sync_message;
+}
+
+static void _set_sync_reply(XW_Instance instance G_GNUC_UNUSED, const char* reply)
+{
+    g_free(_reply);
+    _reply = g_strdup(reply);
+}
+
+static const XW_Internal_SyncMessagingInterface _fake_sync_messaging = {
+    _register_sync,
+    _set_sync_reply,
+};
+
+
+static const void* _get_interface(const char* name)
+{
+    if (g_strcmp0(name, XW_CORE_INTERFACE) == 0)
+        return &_fake_core;
+    if (g_strcmp0(name, XW_MESSAGING_INTERFACE) == 0)
+        return &_fake_messaging;
+    if (g_strcmp0(name, XW_INTERNAL_SYNC_MESSAGING_INTERFACE) == 0)
+        return &_fake_sync_messaging;
+    return NULL;
+}
+
+
+void bench_xwalk_init()
+{
+    if (_handle_sync_message == NULL)
+        XW_Initialize(BENCH_EXTENSION, _get_interface);
+}
+
+
+const char* bench_sync_call(const char* msg)
+{
+    bench_xwalk_init();
+    _handle_sync_message(BENCH_INSTANCE, msg);
+    return _reply;
+}
@@ -26,6 +26,109 @@
 #include "X_misc.h"
 //#include "dwebview.h"
 
+static const char* _atom_names[ATOM_COUNT] = {
+    [ATOM_NET_WORKAREA] = "_NET_WORKAREA",
+    [ATOM_NET_ACTIVE_WINDOW] = "_NET_ACTIVE_WINDOW",
+    [ATOM_NET_CLIENT_LIST] = "_NET_CLIENT_LIST",
+    [ATOM_NET_WM_PID] = "_NET_WM_PID",
+    [ATOM_NET_WM_WINDOW_TYPE] = "_NET_WM_WINDOW_TYPE",
+    [ATOM_NET_WM_WINDOW_TYPE_DESKTOP] = "_NET_WM_WINDOW_TYPE_DESKTOP",
+    [ATOM_NET_WM_WINDOW_TYPE_DOCK] = "_NET_WM_WINDOW_TYPE_DOCK",
+    [ATOM_NET_WM_STRUT_PARTIAL] = "_NET_WM_STRUT_PARTIAL",
+    [ATOM_NET_WM_STATE] = "_NET_WM_STATE",
+    [ATOM_NET_WM_STATE_MAXIMIZED_VERT] = "_NET_WM_STATE_MAXIMIZED_VERT",
+};
+static Atom _atoms[ATOM_COUNT];
+static gboolean _atoms_inited = FALSE;
+
+
+/*
+ * All the atoms are interned with a single XInternAtoms round trip the first
+ * time any of them is needed.
+ */
+Atom get_atom(AtomId id)
+{
+    g_return_val_if_fail(id < ATOM_COUNT, None);
+
+    if (!_atoms_inited) {
+        XInternAtoms(gdk_x11_get_default_xdisplay(), (char**)_atom_names,
+                     ATOM_COUNT, False, _atoms);
+        _atoms_inited = TRUE;
+    }
+
+    return _atoms[id];
+}
+
+
+typedef struct _RootPropertyWatch {
+    Atom atom;
+    RootPropertyHandler handler;
+    gpointer user_data;
+} RootPropertyWatch;
+
+static GArray* _root_watches = NULL;
+
+
+static GdkFilterReturn _root_window_filter(GdkXEvent* gxevent, GdkEvent* event G_GNUC_UNUSED,
+                                           gpointer user_data G_GNUC_UNUSED)
+{
+    XPropertyEvent* xevt = (XPropertyEvent*)gxevent;
+    if (xevt->type != PropertyNotify)
+        return GDK_FILTER_CONTINUE;
+
+    // a handler may unwatch itself, so don't keep pointers into the array.
+    for (guint i = 0; _root_watches != NULL && i < _root_watches->len; ++i) {
+        RootPropertyWatch watch = g_array_index(_root_watches, RootPropertyWatch, i);
+        if (watch.atom != xevt->atom)
+            continue;
+
+        watch.handler(xevt, watch.user_data);
+        if (_root_watches == NULL || i >= _root_watches->len)
+            continue;
+        RootPropertyWatch* current = &g_array_index(_root_watches, RootPropertyWatch, i);
+        if (current->handler != watch.handler || current->user_data != watch.user_data)
+            --i;
+    }
+
+    return GDK_FILTER_CONTINUE;
+}
+
+
+void watch_root_property(AtomId id, RootPropertyHandler handler, gpointer user_data)
+{
+    GdkWindow* root = gdk_get_default_root_window();
+
+    if (_root_watches == NULL) {
+        _root_watches = g_array_new(FALSE, FALSE, sizeof(RootPropertyWatch));
+        gdk_window_set_events(root, gdk_window_get_events(root) | GDK_PROPERTY_CHANGE_MASK);
+        gdk_window_add_filter(root, _root_window_filter, NULL);
+    }
+
+    RootPropertyWatch watch = { get_atom(id), handler, user_data };
+    g_array_append_val(_root_watches, watch);
+}
+
+
+void unwatch_root_property(AtomId id, RootPropertyHandler handler, gpointer user_data)
+{
+    if (_root_watches == NULL)
+        return;
+
+    Atom atom = get_atom(id);
+    for (guint i = _root_watches->len; i > 0; --i) {
+        RootPropertyWatch* watch = &g_array_index(_root_watches, RootPropertyWatch, i - 1);
+        if (watch->atom == atom && watch->handler == handler && watch->user_data == user_data)
+            g_array_remove_index(_root_watches, i - 1);
+    }
+
+    if (_root_watches->len == 0) {
+        gdk_window_remove_filter(gdk_get_default_root_window(), _root_window_filter, NULL);
+        g_array_free(_root_watches, TRUE);
+        _root_watches = NULL;
+    }
+}
+
+
 void set_wmspec_desktop_hint (GdkWindow *window)
 {
     GdkAtom atom = gdk_atom_intern ("_NET_WM_WINDOW_TYPE_DESKTOP", FALSE);
@@ -49,7 +152,7 @@ void set_wmspec_dock_hint(GdkWindow *window)
 void get_workarea_size(int* x, int* y, int* width, int* height)
 {
     Display *dpy = gdk_x11_get_default_xdisplay();
-    Atom property = XInternAtom(dpy, "_NET_WORKAREA", False);
+    Atom property = get_atom(ATOM_NET_WORKAREA);
     gulong items;
     gulong* data = get_window_property(dpy, GDK_ROOT_WINDOW(), property, &items);
 
@@ -135,7 +238,6 @@ enum {
 };
 
 
-static Atom net_wm_strut_partial      = None;
 void set_struct_partial(GdkWindow* gdk_window, guint32 orientation, guint32 strut, guint32 strut_start, guint32 strut_end)
 {
     Display *display;
@@ -147,9 +249,6 @@ void set_struct_partial(GdkWindow* gdk_window, guint32 orientation, guint32 stru
     display = GDK_WINDOW_XDISPLAY (gdk_window);
     window  = GDK_WINDOW_XID (gdk_window);
 
-    if (net_wm_strut_partial == None)
-        net_wm_strut_partial = XInternAtom (display, "_NET_WM_STRUT_PARTIAL", False);
-
     switch (orientation) {
         case ORIENTATION_LEFT:
             struts [STRUT_LEFT] = strut;
@@ -174,7 +273,7 @@ void set_struct_partial(GdkWindow* gdk_window, guint32 orientation, guint32 stru
     }
 
     gdk_error_trap_push ();
-    XChangeProperty (display, window, net_wm_strut_partial,
+    XChangeProperty (display, window, get_atom(ATOM_NET_WM_STRUT_PARTIAL),
             XA_CARDINAL, 32, PropModeReplace,
             (guchar *) &struts, 12);
     gdk_error_trap_pop_ignored ();
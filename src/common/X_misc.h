@@ -23,6 +23,32 @@
 
 #include <gtk/gtk.h>
 #include <gdk/gdkx.h>
+
+/* atoms interned once for the whole process, see get_atom */
+typedef enum {
+    ATOM_NET_WORKAREA,
+    ATOM_NET_ACTIVE_WINDOW,
+    ATOM_NET_CLIENT_LIST,
+    ATOM_NET_WM_PID,
+    ATOM_NET_WM_WINDOW_TYPE,
+    ATOM_NET_WM_WINDOW_TYPE_DESKTOP,
+    ATOM_NET_WM_WINDOW_TYPE_DOCK,
+    ATOM_NET_WM_STRUT_PARTIAL,
+    ATOM_NET_WM_STATE,
+    ATOM_NET_WM_STATE_MAXIMIZED_VERT,
+    ATOM_COUNT
+} AtomId;
+
+Atom get_atom(AtomId id);
+
+/*
+ * One filter on the root window dispatches PropertyNotify events to the
+ * handlers registered for the changed property.
+ */
+typedef void (*RootPropertyHandler)(XPropertyEvent* event, gpointer user_data);
+void watch_root_property(AtomId id, RootPropertyHandler handler, gpointer user_data);
+void unwatch_root_property(AtomId id, RootPropertyHandler handler, gpointer user_data);
+
 void set_wmspec_desktop_hint(GdkWindow *window);
 void set_wmspec_dock_hint(GdkWindow *window);
 
@@ -0,0 +1,326 @@
+/**
+ * Copyright (c) 2011 ~ 2012 Deepin, Inc.
+ *               2011 ~ 2012 snyh
+ *
+ * Author:      snyh <snyh@snyh.org>
+ * Maintainer:  snyh <snyh@snyh.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ **/
+#include <string.h>
+#include <sys/stat.h>
+#include <glib.h>
+#include <gio/gio.h>
+#include <gio/gdesktopappinfo.h>
+
+#include "app_index.h"
+
+/*
+ * The .desktop files under every XDG applications dir are parsed once into
+ * an id -> AppIndexEntry map. The dirs are watched, a changed or new file is
+ * parsed again on its own, while a removed one (which may unmask the same id
+ * in another dir) marks the index for a full rescan on the next lookup.
+ * An applications dir that doesn't exist yet (like ~/.local/share/applications
+ * on a new account) is waited for by watching its nearest existing parent.
+ */
+
+static GHashTable* _entries = NULL; // id -> AppIndexEntry*
+static GPtrArray* _app_dirs = NULL; // in priority order
+static GPtrArray* _monitors = NULL;
+static gboolean _need_rescan = TRUE;
+
+
+static
+void _entry_free(AppIndexEntry* entry)
+{
+    g_free(entry->id);
+    g_free(entry->path);
+    g_free(entry->name);
+    g_free(entry->localized_name);
+    g_free(entry->icon);
+    g_free(entry->exec);
+    if (entry->info != NULL)
+        g_object_unref(entry->info);
+    g_slice_free(AppIndexEntry, entry);
+}
+
+
+static
+AppIndexEntry* _parse_desktop_file(char const* path, char const* id, guint dir_index)
+{
+    GKeyFile* file = g_key_file_new();
+    if (!g_key_file_load_from_file(file, path, G_KEY_FILE_NONE, NULL)) {
+        g_key_file_free(file);
+        return NULL;
+    }
+
+    AppIndexEntry* entry = NULL;
+    char* type = g_key_file_get_string(file, G_KEY_FILE_DESKTOP_GROUP, G_KEY_FILE_DESKTOP_KEY_TYPE, NULL);
+    if (g_strcmp0(type, G_KEY_FILE_DESKTOP_TYPE_APPLICATION) != 0)
+        goto out;
+
+    entry = g_slice_new0(AppIndexEntry);
+    entry->id = g_strdup(id);
+    entry->path = g_strdup(path);
+    entry->dir_index = dir_index;
+    entry->hidden = g_key_file_get_boolean(file, G_KEY_FILE_DESKTOP_GROUP, G_KEY_FILE_DESKTOP_KEY_HIDDEN, NULL);
+
+    // like g_desktop_app_info_new, an app whose TryExec is missing doesn't
+    // exist.
+    char* try_exec = g_key_file_get_string(file, G_KEY_FILE_DESKTOP_GROUP, G_KEY_FILE_DESKTOP_KEY_TRY_EXEC, NULL);
+    if (try_exec != NULL && try_exec[0] != '\0') {
+        char* program = g_find_program_in_path(try_exec);
+        if (program == NULL)
+            entry->hidden = TRUE;
+        g_free(program);
+    }
+    g_free(try_exec);
+
+    if (!entry->hidden) {
+        entry->name = g_key_file_get_string(file, G_KEY_FILE_DESKTOP_GROUP, G_KEY_FILE_DESKTOP_KEY_NAME, NULL);
+        entry->localized_name = g_key_file_get_locale_string(file, G_KEY_FILE_DESKTOP_GROUP, G_KEY_FILE_DESKTOP_KEY_NAME, NULL, NULL);
+        entry->icon = g_key_file_get_locale_string(file, G_KEY_FILE_DESKTOP_GROUP, G_KEY_FILE_DESKTOP_KEY_ICON, NULL, NULL);
+        entry->exec = g_key_file_get_string(file, G_KEY_FILE_DESKTOP_GROUP, G_KEY_FILE_DESKTOP_KEY_EXEC, NULL);
+    }
+
+out:
+    g_free(type);
+    g_key_file_free(file);
+    return entry;
+}
+
+
+/*
+ * Put @entry in the index unless an entry from a dir with higher priority
+ * owns the id, take the ownership of @entry.
+ */
+static
+void _insert_entry(AppIndexEntry* entry)
+{
+    AppIndexEntry* old = g_hash_table_lookup(_entries, entry->id);
+    if (old != NULL && old->dir_index < entry->dir_index) {
+        _entry_free(entry);
+        return;
+    }
+
+    g_hash_table_replace(_entries, entry->id, entry);
+}
+
+
+static
+char* _get_desktop_id(char const* app_dir, char const* path)
+{
+    gsize len = strlen(app_dir);
+    if (!g_str_has_prefix(path, app_dir) || path[len] != G_DIR_SEPARATOR
+        || !g_str_has_suffix(path, ".desktop"))
+        return NULL;
+
+    // applications/kde4/konsole.desktop has the id kde4-konsole.desktop
+    char* id = g_strndup(path + len + 1, strlen(path) - len - 1 - strlen(".desktop"));
+    g_strdelimit(id, G_DIR_SEPARATOR_S, '-');
+    return id;
+}
+
+
+static void _app_dir_changed(GFileMonitor*, GFile*, GFile*, GFileMonitorEvent, gpointer);
+
+
+static
+void _parent_dir_changed(GFileMonitor* monitor G_GNUC_UNUSED, GFile* file,
+                         GFile* other_file G_GNUC_UNUSED, GFileMonitorEvent event_type,
+                         gpointer user_data)
+{
+    if (event_type != G_FILE_MONITOR_EVENT_CREATED)
+        return;
+
+    // the missing app dir or one of its parents was created.
+    char const* app_dir = g_ptr_array_index(_app_dirs, GPOINTER_TO_UINT(user_data));
+    char* path = g_file_get_path(file);
+    gsize len = strlen(path);
+    if (g_str_has_prefix(app_dir, path) && (app_dir[len] == '\0' || app_dir[len] == G_DIR_SEPARATOR))
+        _need_rescan = TRUE;
+    g_free(path);
+}
+
+
+static
+void _watch_missing_dir(char const* app_dir, guint dir_index)
+{
+    char* parent = g_path_get_dirname(app_dir);
+    while (!g_file_test(parent, G_FILE_TEST_IS_DIR)) {
+        char* next = g_path_get_dirname(parent);
+        gboolean is_root = g_strcmp0(next, parent) == 0;
+        g_free(parent);
+        parent = next;
+        if (is_root)
+            break;
+    }
+
+    GFile* file = g_file_new_for_path(parent);
+    GFileMonitor* monitor = g_file_monitor_directory(file, G_FILE_MONITOR_NONE, NULL, NULL);
+    g_object_unref(file);
+    if (monitor != NULL) {
+        g_signal_connect(monitor, "changed", G_CALLBACK(_parent_dir_changed), GUINT_TO_POINTER(dir_index));
+        g_ptr_array_add(_monitors, monitor);
+    }
+    g_free(parent);
+}
+
+
+/*
+ * @visited holds the "dev:ino" of the dirs scanned already, a symlink loop
+ * in an applications dir ends there.
+ */
+static
+void _scan_dir(char const* app_dir, char const* dir_path, guint dir_index,
+               GHashTable* visited)
+{
+    struct stat st;
+    if (stat(dir_path, &st) != 0 || !S_ISDIR(st.st_mode)) {
+        if (g_strcmp0(dir_path, app_dir) == 0)
+            _watch_missing_dir(app_dir, dir_index);
+        return;
+    }
+
+    char* key = g_strdup_printf("%lu:%lu", (gulong)st.st_dev, (gulong)st.st_ino);
+    if (g_hash_table_contains(visited, key)) {
+        g_free(key);
+        return;
+    }
+    g_hash_table_add(visited, key);
+
+    GDir* dir = g_dir_open(dir_path, 0, NULL);
+    if (dir == NULL)
+        return;
+
+    GFile* file = g_file_new_for_path(dir_path);
+    GFileMonitor* monitor = g_file_monitor_directory(file, G_FILE_MONITOR_NONE, NULL, NULL);
+    g_object_unref(file);
+    if (monitor != NULL) {
+        g_signal_connect(monitor, "changed", G_CALLBACK(_app_dir_changed), GUINT_TO_POINTER(dir_index));
+        g_ptr_array_add(_monitors, monitor);
+    }
+
+    char const* name = NULL;
+    while ((name = g_dir_read_name(dir)) != NULL) {
+        char* path = g_build_filename(dir_path, name, NULL);
+        if (g_str_has_suffix(name, ".desktop")) {
+            char* id = _get_desktop_id(app_dir, path);
+            AppIndexEntry* entry = _parse_desktop_file(path, id, dir_index);
+            if (entry != NULL)
+                _insert_entry(entry);
+            g_free(id);
+        } else if (g_file_test(path, G_FILE_TEST_IS_DIR)) {
+            _scan_dir(app_dir, path, dir_index, visited);
+        }
+        g_free(path);
+    }
+
+    g_dir_close(dir);
+}
+
+
+static
+void _rescan()
+{
+    if (_entries == NULL) {
+        _entries = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, (GDestroyNotify)_entry_free);
+        _monitors = g_ptr_array_new_with_free_func(g_object_unref);
+        _app_dirs = g_ptr_array_new_with_free_func(g_free);
+
+        g_ptr_array_add(_app_dirs, g_build_filename(g_get_user_data_dir(), "applications", NULL));
+        char const* const* dirs = g_get_system_data_dirs();
+        for (int i = 0; dirs[i] != NULL; ++i)
+            g_ptr_array_add(_app_dirs, g_build_filename(dirs[i], "applications", NULL));
+    } else {
+        g_hash_table_remove_all(_entries);
+        g_ptr_array_set_size(_monitors, 0);
+    }
+
+    GHashTable* visited = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    for (guint i = 0; i < _app_dirs->len; ++i) {
+        char const* app_dir = g_ptr_array_index(_app_dirs, i);
+        _scan_dir(app_dir, app_dir, i, visited);
+    }
+    g_hash_table_unref(visited);
+
+    _need_rescan = FALSE;
+    g_debug("[%s] %u apps indexed", __func__, g_hash_table_size(_entries));
+}
+
+
+static
+void _app_dir_changed(GFileMonitor* monitor G_GNUC_UNUSED, GFile* file,
+                      GFile* other_file G_GNUC_UNUSED, GFileMonitorEvent event_type,
+                      gpointer user_data)
+{
+    if (_need_rescan)
+        return;
+
+    guint dir_index = GPOINTER_TO_UINT(user_data);
+    char* path = g_file_get_path(file);
+    char* id = _get_desktop_id(g_ptr_array_index(_app_dirs, dir_index), path);
+
+    switch (event_type) {
+    case G_FILE_MONITOR_EVENT_CHANGES_DONE_HINT:
+    case G_FILE_MONITOR_EVENT_CREATED:
+        if (id != NULL) {
+            AppIndexEntry* entry = _parse_desktop_file(path, id, dir_index);
+            if (entry != NULL)
+                _insert_entry(entry);
+            else
+                _need_rescan = TRUE;
+        } else if (g_file_test(path, G_FILE_TEST_IS_DIR)) {
+            _need_rescan = TRUE;
+        }
+        break;
+    case G_FILE_MONITOR_EVENT_DELETED:
+    case G_FILE_MONITOR_EVENT_MOVED:
+        // another dir may have the same id, let the rescan sort it out.
+        _need_rescan = TRUE;
+        break;
+    default:
+        break;
+    }
+
+    g_free(id);
+    g_free(path);
+}
+
+
+const AppIndexEntry* app_index_lookup(char const* app_id)
+{
+    if (_need_rescan)
+        _rescan();
+
+    AppIndexEntry* entry = g_hash_table_lookup(_entries, app_id);
+    if (entry == NULL || entry->hidden)
+        return NULL;
+
+    return entry;
+}
+
+
+GDesktopAppInfo* app_index_get_app_info(char const* app_id)
+{
+    AppIndexEntry* entry = (AppIndexEntry*)app_index_lookup(app_id);
+    if (entry == NULL)
+        return NULL;
+
+    // the index already resolved the id, don't search the data dirs again.
+    if (entry->info == NULL)
+        entry->info = g_desktop_app_info_new_from_filename(entry->path);
+
+    return entry->info != NULL ? g_object_ref(entry->info) : NULL;
+}
@@ -0,0 +1,24 @@
+#ifndef _APP_INDEX_H_
+#define _APP_INDEX_H_
+
+#include <glib.h>
+#include <gio/gdesktopappinfo.h>
+
+typedef struct _AppIndexEntry {
+    char* id; // desktop id without ".desktop", e.g. "kde4-konsole"
+    char* path;
+    char* name; // untranslated Name
+    char* localized_name;
+    char* icon;
+    char* exec;
+    gboolean hidden; // Hidden=true, masks the same id in later dirs
+    guint dir_index; // smaller wins, the user dir is 0
+    GDesktopAppInfo* info; // created on demand
+} AppIndexEntry;
+
+// the entry is owned by the index and stays valid until the main loop runs
+// again, NULL if no such app.
+const AppIndexEntry* app_index_lookup(char const* app_id);
+GDesktopAppInfo* app_index_get_app_info(char const* app_id); // new reference
+
+#endif
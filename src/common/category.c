@@ -26,9 +26,13 @@
 #include "sqlite3.h"
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <string.h>
 #include <unistd.h>
 #include <glib.h>
 #include <glib/gprintf.h>
+#include <glib/gstdio.h>
 #include "config.h"
 
 #define DEEPIN_SOFTWARE_CENTER_DATA_DIR    "/usr/share/deepin-software-center/data"
@@ -67,7 +71,7 @@ gboolean _need_to_update(const char* db_path)
 
     static time_t _last_modify_time[2] = {0};
     struct stat newest;
-    if (!stat(DATA_NEWEST_ID, &newest)) {
+    if (stat(DATA_NEWEST_ID, &newest) != 0) {
         return FALSE;
     }
 
@@ -136,3 +140,315 @@ gboolean search_database(const char* db_path, const char* sql, SQLEXEC_CB fn, vo
     return is_good;
 }
 
+
+/*
+ * The desktop_name -> first_category_name table and the category filters are
+ * only changed by software center data updates, so they are loaded once into
+ * memory and reloaded only when DATA_NEWEST_ID is touched. All strings are
+ * interned, callers must not free them.
+ */
+#define CATEGORY_FILTER DATA_DIR"/category_filter.ini"
+
+static time_t _category_map_version = 0;
+static GHashTable* _category_map = NULL;
+static GHashTable* _filtered_categories = NULL;
+static GHashTable* _generic_categories = NULL;
+static gboolean _filter_loaded = FALSE;
+
+
+PRIVATE
+int _add_category_map_item(void* map, int argc, char** argv, char** columnname G_GNUC_UNUSED)
+{
+    if (argc < 2 || argv[0] == NULL || argv[1] == NULL || argv[1][0] == '\0')
+        return 0;
+
+    g_hash_table_insert((GHashTable*)map,
+                        (gpointer)g_intern_string(argv[0]),
+                        (gpointer)g_intern_string(argv[1]));
+    return 0;
+}
+
+
+PRIVATE
+GHashTable* _load_filter_set(GKeyFile* filter_file, char const* group)
+{
+    GHashTable* set = g_hash_table_new(g_str_hash, g_str_equal);
+    gsize size = 0;
+    char** filter = g_key_file_get_string_list(filter_file, group, "filter", &size, NULL);
+
+    for (gsize i = 0; i < size; ++i)
+        g_hash_table_add(set, (gpointer)g_intern_string(filter[i]));
+
+    g_strfreev(filter);
+    return set;
+}
+
+
+PRIVATE
+void _load_category_filters()
+{
+    g_clear_pointer(&_filtered_categories, g_hash_table_unref);
+    g_clear_pointer(&_generic_categories, g_hash_table_unref);
+
+    GKeyFile* filter_file = g_key_file_new();
+    GError* err = NULL;
+    _filter_loaded = g_key_file_load_from_file(filter_file, CATEGORY_FILTER,
+                                               G_KEY_FILE_NONE, &err);
+    if (!_filter_loaded) {
+        g_warning("[Error] read file %s failed: %s", CATEGORY_FILTER, err->message);
+        g_error_free(err);
+    } else {
+        _filtered_categories = _load_filter_set(filter_file, "Main");
+        _generic_categories = _load_filter_set(filter_file, "Aux");
+    }
+
+    g_key_file_unref(filter_file);
+}
+
+
+char* category_map_get_snapshot_path()
+{
+    return g_build_filename(g_get_user_cache_dir(), "deepin", "launcher", "category.snapshot", NULL);
+}
+
+
+/*
+ * The first lookup of a process tries the snapshot a restarted launcher left
+ * behind before going to the databases.
+ */
+PRIVATE
+gboolean _restore_snapshot_once()
+{
+    static gboolean tried = FALSE;
+    if (tried)
+        return FALSE;
+    tried = TRUE;
+
+    char* path = category_map_get_snapshot_path();
+    gboolean restored = category_map_load_snapshot(path);
+    if (restored)
+        g_message("[%s] category map restored from %s", __func__, path);
+    g_free(path);
+
+    return restored;
+}
+
+
+PRIVATE
+void _update_category_map()
+{
+    if (_category_map == NULL && _restore_snapshot_once())
+        return;
+
+    struct stat newest;
+    time_t version = 0;
+    if (stat(DATA_NEWEST_ID, &newest) == 0)
+        version = newest.st_mtime;
+
+    if (_category_map != NULL && version == _category_map_version)
+        return;
+
+    _category_map_version = version;
+
+    if (_category_map == NULL)
+        _category_map = g_hash_table_new(g_str_hash, g_str_equal);
+    else
+        g_hash_table_remove_all(_category_map);
+
+    if (version != 0)
+        search_database(get_category_name_db_path(),
+                        "select desktop_name, first_category_name from desktop;",
+                        _add_category_map_item, _category_map);
+
+    g_debug("[%s] load %u items", __func__, g_hash_table_size(_category_map));
+    _load_category_filters();
+}
+
+
+GHashTable* get_category_map()
+{
+    _update_category_map();
+    return _category_map;
+}
+
+
+gboolean is_filtered_category(char const* category)
+{
+    if (_category_map == NULL)
+        _update_category_map();
+
+    if (!_filter_loaded)
+        return FALSE;
+
+    return g_hash_table_contains(_filtered_categories, category);
+}
+
+
+gboolean is_generic_category(char const* category)
+{
+    if (_category_map == NULL)
+        _update_category_map();
+
+    // keep the old behaviour: every category is generic without filter file.
+    if (!_filter_loaded)
+        return TRUE;
+
+    return g_hash_table_contains(_generic_categories, category);
+}
+
+
+/*
+ * The category map can be saved to a snapshot file and mapped back by a
+ * restarted process, which skips the sqlite query. The file is
+ *
+ *   CategorySnapshotHeader
+ *   guint32 pairs[count][2]   (desktop name, category) offsets in the pool
+ *   char pool[pool_size]      NUL terminated strings
+ *
+ * and is only used while DATA_NEWEST_ID has the mtime recorded in it. The
+ * strings are interned in place, so the mapping is never unmapped.
+ */
+#define CATEGORY_SNAPSHOT_MAGIC "DDECATM1"
+
+typedef struct _CategorySnapshotHeader {
+    char magic[8];
+    gint64 version;
+    guint32 count;
+    guint32 pool_size;
+} CategorySnapshotHeader;
+
+
+PRIVATE
+guint32 _pool_add(GString* pool, GHashTable* offsets, char const* str)
+{
+    gpointer offset = NULL;
+    if (g_hash_table_lookup_extended(offsets, str, NULL, &offset))
+        return GPOINTER_TO_UINT(offset);
+
+    guint32 new_offset = pool->len;
+    g_string_append_len(pool, str, strlen(str) + 1);
+    g_hash_table_insert(offsets, (gpointer)str, GUINT_TO_POINTER(new_offset));
+    return new_offset;
+}
+
+
+gboolean category_map_save_snapshot(char const* path)
+{
+    GHashTable* map = get_category_map();
+    if (_category_map_version == 0)
+        return FALSE;
+
+    CategorySnapshotHeader header;
+    memcpy(header.magic, CATEGORY_SNAPSHOT_MAGIC, sizeof(header.magic));
+    header.version = _category_map_version;
+    header.count = g_hash_table_size(map);
+
+    GArray* pairs = g_array_sized_new(FALSE, FALSE, sizeof(guint32), header.count * 2);
+    GString* pool = g_string_new(NULL);
+    GHashTable* offsets = g_hash_table_new(g_direct_hash, g_direct_equal);
+
+    GHashTableIter iter;
+    gpointer key = NULL, value = NULL;
+    g_hash_table_iter_init(&iter, map);
+    while (g_hash_table_iter_next(&iter, &key, &value)) {
+        guint32 pair[2] = {
+            _pool_add(pool, offsets, key),
+            _pool_add(pool, offsets, value)
+        };
+        g_array_append_vals(pairs, pair, 2);
+    }
+    header.pool_size = pool->len;
+
+    GString* content = g_string_sized_new(sizeof(header) + pairs->len * sizeof(guint32) + pool->len);
+    g_string_append_len(content, (char const*)&header, sizeof(header));
+    g_string_append_len(content, pairs->data, pairs->len * sizeof(guint32));
+    g_string_append_len(content, pool->str, pool->len);
+
+    GError* err = NULL;
+    gboolean ok = g_file_set_contents(path, content->str, content->len, &err);
+    if (!ok) {
+        g_warning("[%s] save %s failed: %s", __func__, path, err->message);
+        g_error_free(err);
+    }
+
+    g_string_free(content, TRUE);
+    g_hash_table_unref(offsets);
+    g_string_free(pool, TRUE);
+    g_array_free(pairs, TRUE);
+
+    return ok;
+}
+
+
+gboolean category_map_load_snapshot(char const* path)
+{
+    struct stat newest;
+    if (stat(DATA_NEWEST_ID, &newest) != 0)
+        return FALSE;
+
+    int fd = g_open(path, O_RDONLY, 0);
+    if (fd == -1)
+        return FALSE;
+
+    struct stat st;
+    void* data = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && (size_t)st.st_size >= sizeof(CategorySnapshotHeader))
+        data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (data == MAP_FAILED)
+        return FALSE;
+
+    CategorySnapshotHeader const* header = data;
+    guint32 const* pairs = (guint32 const*)(header + 1);
+    char const* pool = (char const*)(pairs + (gsize)header->count * 2);
+    gsize expected = sizeof(*header) + (gsize)header->count * 2 * sizeof(guint32) + header->pool_size;
+
+    gboolean valid = memcmp(header->magic, CATEGORY_SNAPSHOT_MAGIC, sizeof(header->magic)) == 0
+        && header->version == (gint64)newest.st_mtime
+        && expected == (gsize)st.st_size
+        && (header->pool_size == 0 || pool[header->pool_size - 1] == '\0');
+    for (guint32 i = 0; valid && i < header->count * 2; ++i)
+        valid = pairs[i] < header->pool_size;
+
+    if (!valid) {
+        g_debug("[%s] %s is stale or broken", __func__, path);
+        munmap(data, st.st_size);
+        return FALSE;
+    }
+
+    if (_category_map == NULL)
+        _category_map = g_hash_table_new(g_str_hash, g_str_equal);
+    else
+        g_hash_table_remove_all(_category_map);
+
+    for (guint32 i = 0; i < header->count; ++i)
+        g_hash_table_insert(_category_map,
+                            (gpointer)g_intern_static_string(pool + pairs[i * 2]),
+                            (gpointer)g_intern_static_string(pool + pairs[i * 2 + 1]));
+    _category_map_version = newest.st_mtime;
+
+    g_debug("[%s] load %u items from %s", __func__, header->count, path);
+    _load_category_filters();
+    return TRUE;
+}
+
+
+gsize category_map_memory_size()
+{
+    if (_category_map == NULL)
+        return 0;
+
+    // the interned strings and a rough cost of the hash table nodes.
+    gsize size = 0;
+    GHashTableIter iter;
+    gpointer key = NULL, value = NULL;
+    g_hash_table_iter_init(&iter, _category_map);
+    while (g_hash_table_iter_next(&iter, &key, &value))
+        size += strlen(key) + 1 + 3 * sizeof(gpointer);
+
+    return size;
+}
+
+#undef CATEGORY_SNAPSHOT_MAGIC
+#undef CATEGORY_FILTER
@@ -51,4 +51,15 @@ const char* get_category_index_db_path();
 const char* get_category_name_db_path();
 gboolean search_database(const char* db_path, const char* sql, SQLEXEC_CB fn, void* res);
 
+GHashTable* get_category_map(); // desktop_name -> first_category_name, don't free
+gboolean is_filtered_category(char const* category);
+gboolean is_generic_category(char const* category);
+
+// used to hand the category map over to a restarted launcher, the snapshot
+// at category_map_get_snapshot_path is loaded on the first lookup.
+char* category_map_get_snapshot_path();
+gboolean category_map_save_snapshot(char const* path);
+gboolean category_map_load_snapshot(char const* path);
+gsize category_map_memory_size();
+
 #endif
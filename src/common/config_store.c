@@ -0,0 +1,262 @@
+/**
+ * Copyright (c) 2011 ~ 2012 Deepin, Inc.
+ *               2011 ~ 2012 snyh
+ *
+ * Author:      snyh <snyh@snyh.org>
+ * Maintainer:  snyh <snyh@snyh.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ **/
+#define _GNU_SOURCE
+#include <sys/stat.h>
+#include <stdlib.h>
+
+#include <glib.h>
+#include <gio/gio.h>
+
+#include "utils.h"
+#include "config_store.h"
+
+/*
+ * The app configs are loaded once and kept in memory. Writers only record
+ * the keys they set; the config is written out (atomically, see
+ * write_to_file) after CONFIG_FLUSH_DELAY_MS, so a burst of changes costs
+ * one write. The files
+ * are watched and an edit from another process is loaded; the keys still
+ * pending here are applied again on top of it, so neither side's changes
+ * are lost.
+ */
+#define CONFIG_FLUSH_DELAY_MS 500
+
+typedef struct _ConfigFile {
+    char* path;
+    GKeyFile* key_file;
+    GKeyFile* pending; // the keys set since the last write, NULL if none
+    GFileMonitor* monitor;
+    // what our last write left on disk, to tell it from external edits.
+    // g_file_set_contents and sed -i replace the file, so the inode changes
+    // even when an edit lands in the same mtime tick with the same size.
+    struct timespec mtime;
+    ino_t ino;
+    off_t size;
+} ConfigFile;
+
+/* name -> ConfigFile */
+static GHashTable* _configs = NULL;
+static guint _flush_id = 0;
+
+
+static
+void _stat_config(ConfigFile* config)
+{
+    struct stat st;
+    if (stat(config->path, &st) == 0) {
+        config->mtime = st.st_mtim;
+        config->ino = st.st_ino;
+        config->size = st.st_size;
+    } else {
+        config->mtime.tv_sec = 0;
+        config->mtime.tv_nsec = 0;
+        config->ino = 0;
+        config->size = -1;
+    }
+}
+
+
+static
+void _config_file_free(ConfigFile* config)
+{
+    if (config->monitor != NULL)
+        g_object_unref(config->monitor);
+    g_key_file_unref(config->key_file);
+    if (config->pending != NULL)
+        g_key_file_unref(config->pending);
+    g_free(config->path);
+    g_slice_free(ConfigFile, config);
+}
+
+
+static
+void _apply_pending(ConfigFile* config, GKeyFile* key_file)
+{
+    gchar** groups = g_key_file_get_groups(config->pending, NULL);
+    for (int i = 0; groups[i] != NULL; ++i) {
+        gchar** keys = g_key_file_get_keys(config->pending, groups[i], NULL, NULL);
+        for (int j = 0; keys != NULL && keys[j] != NULL; ++j) {
+            gchar* value = g_key_file_get_value(config->pending, groups[i], keys[j], NULL);
+            g_key_file_set_value(key_file, groups[i], keys[j], value);
+            g_free(value);
+        }
+        g_strfreev(keys);
+    }
+    g_strfreev(groups);
+}
+
+
+/*
+ * Load the file again if another process changed it since our last write,
+ * keeping the keys still pending here.
+ */
+static
+void _reload_if_changed(ConfigFile* config)
+{
+    struct timespec mtime = config->mtime;
+    ino_t ino = config->ino;
+    off_t size = config->size;
+    _stat_config(config);
+    if (config->mtime.tv_sec == mtime.tv_sec && config->mtime.tv_nsec == mtime.tv_nsec
+        && config->ino == ino && config->size == size)
+        return;
+
+    g_debug("[%s] reload %s", __func__, config->path);
+    GKeyFile* key_file = g_key_file_new();
+    if (!g_key_file_load_from_file(key_file, config->path, G_KEY_FILE_KEEP_COMMENTS, NULL)) {
+        g_key_file_unref(key_file);
+        return;
+    }
+
+    if (config->pending != NULL)
+        _apply_pending(config, key_file);
+    g_key_file_unref(config->key_file);
+    config->key_file = key_file;
+}
+
+
+static
+void _config_changed(GFileMonitor* monitor G_GNUC_UNUSED, GFile* file G_GNUC_UNUSED,
+                     GFile* other_file G_GNUC_UNUSED, GFileMonitorEvent event_type,
+                     ConfigFile* config)
+{
+    if (event_type != G_FILE_MONITOR_EVENT_CHANGES_DONE_HINT
+        && event_type != G_FILE_MONITOR_EVENT_CREATED)
+        return;
+
+    _reload_if_changed(config);
+}
+
+
+static
+void _flush_config(ConfigFile* config)
+{
+    if (config->pending == NULL)
+        return;
+
+    // the monitor may not have reported an edit made just now.
+    _reload_if_changed(config);
+
+    gsize size = 0;
+    gchar* content = g_key_file_to_data(config->key_file, &size, NULL);
+    if (write_to_file(config->path, content, size))
+        _stat_config(config);
+    else
+        g_warning("[%s] write %s failed", __func__, config->path);
+    g_free(content);
+
+    g_key_file_unref(config->pending);
+    config->pending = NULL;
+}
+
+
+void config_store_flush()
+{
+    if (_flush_id != 0) {
+        g_source_remove(_flush_id);
+        _flush_id = 0;
+    }
+
+    if (_configs == NULL)
+        return;
+
+    GHashTableIter iter;
+    gpointer value = NULL;
+    g_hash_table_iter_init(&iter, _configs);
+    while (g_hash_table_iter_next(&iter, NULL, &value))
+        _flush_config(value);
+}
+
+
+static
+gboolean _flush_timeout(gpointer user_data G_GNUC_UNUSED)
+{
+    _flush_id = 0;
+    config_store_flush();
+    return G_SOURCE_REMOVE;
+}
+
+
+GKeyFile* config_store_get(const char* name)
+{
+    if (_configs == NULL) {
+        _configs = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+                                         (GDestroyNotify)_config_file_free);
+        atexit(config_store_flush);
+    }
+
+    ConfigFile* config = g_hash_table_lookup(_configs, name);
+    if (config != NULL)
+        return config->key_file;
+
+    config = g_slice_new0(ConfigFile);
+    config->path = g_build_filename(g_get_user_config_dir(), name, NULL);
+    config->key_file = g_key_file_new();
+    g_key_file_load_from_file(config->key_file, config->path, G_KEY_FILE_KEEP_COMMENTS, NULL);
+    _stat_config(config);
+
+    GFile* file = g_file_new_for_path(config->path);
+    config->monitor = g_file_monitor_file(file, G_FILE_MONITOR_NONE, NULL, NULL);
+    g_object_unref(file);
+    if (config->monitor != NULL)
+        g_signal_connect(config->monitor, "changed", G_CALLBACK(_config_changed), config);
+
+    g_hash_table_insert(_configs, g_strdup(name), config);
+    return config->key_file;
+}
+
+
+/*
+ * The ConfigFile of @name with an empty pending key file ready for the
+ * setter, the write is scheduled.
+ */
+static
+ConfigFile* _begin_set(const char* name)
+{
+    config_store_get(name);
+    ConfigFile* config = g_hash_table_lookup(_configs, name);
+
+    if (config->pending == NULL)
+        config->pending = g_key_file_new();
+
+    if (_flush_id == 0)
+        _flush_id = g_timeout_add(CONFIG_FLUSH_DELAY_MS, _flush_timeout, NULL);
+    return config;
+}
+
+
+void config_store_set_string(const char* name, const char* group,
+                             const char* key, const char* value)
+{
+    ConfigFile* config = _begin_set(name);
+    g_key_file_set_string(config->key_file, group, key, value);
+    g_key_file_set_string(config->pending, group, key, value);
+}
+
+
+void config_store_set_string_list(const char* name, const char* group,
+                                  const char* key, const char* const* list,
+                                  gsize length)
+{
+    ConfigFile* config = _begin_set(name);
+    g_key_file_set_string_list(config->key_file, group, key, list, length);
+    g_key_file_set_string_list(config->pending, group, key, list, length);
+}
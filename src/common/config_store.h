@@ -0,0 +1,20 @@
+#ifndef _CONFIG_STORE_H_
+#define _CONFIG_STORE_H_
+
+#include <glib.h>
+
+// @name is relative to the user config dir like load_app_config. The key
+// file is shared by every caller in the process, don't unref it, don't keep
+// it across main loop iterations and change it only through the setters.
+GKeyFile* config_store_get(const char* name);
+
+// set the value and write @name back a moment later, changes made meanwhile
+// share one write.
+void config_store_set_string(const char* name, const char* group,
+                             const char* key, const char* value);
+void config_store_set_string_list(const char* name, const char* group,
+                                  const char* key, const char* const* list,
+                                  gsize length);
+void config_store_flush();
+
+#endif
@@ -21,6 +21,7 @@
 #include "utils.h"
 #include "i18n.h"
 #include "xdg_misc.h"
+#include "app_index.h"
 #include <glib.h>
 #include <glib/gprintf.h>
 #include <sys/stat.h>
@@ -178,14 +179,16 @@ gboolean write_to_file(const char* path, const char* content, size_t size/* if 0
     if (size == 0) {
         size = strlen(content);
     }
-    FILE* f = fopen(path, "w");
-    if (f != NULL) {
-        fwrite(content, sizeof(char), size, f);
-        fclose(f);
-        return TRUE;
-    } else {
+
+    // written to a temp file renamed over @path, a crash or a concurrent
+    // reader never sees a half written file.
+    GError* error = NULL;
+    if (!g_file_set_contents(path, content, size, &error)) {
+        g_warning("write content to %s failed: %s", path, error->message);
+        g_error_free(error);
         return FALSE;
     }
+    return TRUE;
 }
 int close_std_stream()
 {
@@ -286,10 +289,7 @@ char* get_desktop_file_basename(GDesktopAppInfo* file)
 
 GDesktopAppInfo* guess_desktop_file(char const* app_id)
 {
-    char* basename = g_strconcat(app_id, ".desktop", NULL);
-    GDesktopAppInfo* desktop_file = g_desktop_app_info_new(basename);
-    g_free(basename);
-    return desktop_file;
+    return app_index_get_app_info(app_id);
 }
 
 
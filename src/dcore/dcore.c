@@ -31,7 +31,9 @@
 #include "common/pixbuf.h"
 #include "common/config.h"
 #include "common/utils.h"
+#include "common/app_index.h"
 #include "json-c/json.h"
+#include "plugin_registry.h"
 
 #define DESKTOP_SCHEMA_ID "com.deepin.dde.desktop"
 #define DOCK_SCHEMA_ID "com.deepin.dde.dock"
@@ -51,7 +53,10 @@ enum PluginState {
 static void initialize() __attribute__((constructor));
 
 void initialize() {
-  gtk_init(NULL, NULL);
+  // dde-bench loads the modules without a display, the X dependent
+  // functions must not be called then.
+  if (!gtk_init_check(NULL, NULL))
+    g_warning("[%s] cannot open the display", __func__);
 }
 
 //TODO run_command support variable arguments
@@ -66,28 +71,15 @@ char* dcore_get_theme_icon(const char* name, double size)
 JS_EXPORT_API
 char* dcore_get_name_by_appid(const char* id)
 {
-    GDesktopAppInfo* a = guess_desktop_file(id);
-    if (a != NULL) {
-        char* name = g_strdup(g_app_info_get_name(G_APP_INFO(a)));
-        g_object_unref(a);
-        return name;
-    }
+    const AppIndexEntry* app = app_index_lookup(id);
+    if (app != NULL && app->localized_name != NULL)
+        return g_strdup(app->localized_name);
+    if (app != NULL && app->name != NULL)
+        return g_strdup(app->name);
     return g_strdup("");
 }
 
 
-#define IS_DIR(path) g_file_test(path, G_FILE_TEST_IS_DIR)
-
-
-gboolean is_plugin(char const* path)
-{
-    char* info_file_path = g_build_filename(path, "info.ini", NULL);
-    gboolean _is_plugin = g_file_test(info_file_path, G_FILE_TEST_EXISTS);
-    g_free(info_file_path);
-
-    return _is_plugin;
-}
-
 void _init_state(gpointer key, gpointer value G_GNUC_UNUSED, gpointer user_data)
 {
     g_hash_table_replace((GHashTable*)user_data, g_strdup(key), GINT_TO_POINTER(DISABLED_PLUGIN));
@@ -124,6 +116,7 @@ void get_enabled_plugins(GSettings* gsettings, char const* key)
     }
 
     g_strfreev(values);
+    plugin_registry_enabled_changed();
 }
 
 
@@ -150,58 +143,10 @@ void dcore_init_plugins(char const* app_name)
 }
 
 
-void scan_plugin_dir(char const* path, char const* app_name, json_object* array)
-{
-    if (!g_file_test(path, G_FILE_TEST_EXISTS))
-        return;
-
-    GDir* dir = g_dir_open(path, 0, NULL);
-    if (dir != NULL) {
-        const char* file_name = NULL;
-        int i;
-        for (i=0; NULL != (file_name = g_dir_read_name(dir));) {
-            char* full_path = g_build_filename(path, file_name, NULL);
-
-            if (IS_DIR(full_path) && is_plugin(full_path)) {
-                char* js_name = g_strconcat(file_name, ".js", NULL);
-                char* js_path = g_build_filename(full_path, js_name, NULL);
-                g_free(js_name);
-
-                char* key = g_strconcat(app_name, ":", file_name, NULL);
-                if (g_hash_table_contains(enabled_plugins, key)) {
-
-                    json_object* v = json_object_new_string(js_path);
-                    json_object_array_put_idx(array, i++, v);
-                }
-
-                g_free(key);
-                g_free(js_path);
-            }
-
-            g_free(full_path);
-        }
-
-        g_dir_close(dir);
-    }
-}
-
-
-
 JS_EXPORT_API
 json_object* dcore_get_plugins(const char* app_name)
 {
-    json_object* array = json_object_new_array();
-
-    char* path = g_build_filename(RESOURCE_DIR, app_name, "plugin", NULL);
-    scan_plugin_dir(path, app_name, array);
-    g_free(path);
-
-    // TBD
-    path = g_build_filename(getenv("HOME"), ".dde-plugin", app_name, "plugin", NULL);
-    scan_plugin_dir(path, app_name, array);
-    g_free(path);
-
-    return array;
+    return plugin_registry_get_plugins(app_name, enabled_plugins);
 }
 
 
@@ -226,6 +171,7 @@ void enable_plugin(GSettings* gsettings, char const* id, gboolean value)
     GPtrArray* values = g_ptr_array_new_with_free_func(g_free);
     g_hash_table_foreach(enabled_plugins, create_strv, (gpointer)values);
     g_ptr_array_add(values, NULL);
+    plugin_registry_enabled_changed();
     g_settings_set_strv(gsettings, SCHEMA_KEY_ENABLED_PLUGINS, (char const* const*)values->pdata);
     g_ptr_array_unref(values);
     g_settings_sync();
@@ -259,90 +205,7 @@ void trans_to_js_array(char** strv, gsize length, json_object* json)
 JS_EXPORT_API
 json_object* dcore_get_plugin_info(char const* path)
 {
-    char* info_file_path = g_build_filename(path, "info.ini", NULL);
-    GKeyFile* info_file = g_key_file_new();
-    g_key_file_load_from_file(info_file, info_file_path, G_KEY_FILE_NONE, NULL);
-    g_free(info_file_path);
-
-    json_object* json = json_object_new_object();
-    char* id = g_key_file_get_string(info_file, "Plugin", "ID", NULL);
-    json_object_object_add(json, "ID", json_object_new_string(id == NULL ? "" : id));
-    g_free(id);
-
-    char* name = g_key_file_get_string(info_file, "Plugin", "name", NULL);
-    json_object_object_add(json, "name", json_object_new_string(name == NULL ? "" : name));
-    g_free(name);
-
-    char* description = g_key_file_get_string(info_file, "Plugin", "description", NULL);
-    json_object_object_add(json, "description", json_object_new_string(description == NULL ? "" : description));
-    g_free(description);
-
-    int width = g_key_file_get_integer(info_file, "Plugin", "width", NULL);
-    json_object_object_add(json, "width", json_object_new_int(width));
-
-    int height = g_key_file_get_integer(info_file, "Plugin", "height", NULL);
-    json_object_object_add(json, "height", json_object_new_int(height));
-
-    GError* error = NULL;
-    double x = g_key_file_get_double(info_file, "Plugin", "x", &error);
-    if (error) {
-        json_object_object_add(json, "x", json_object_new_object());
-        g_error_free(error);
-    } else {
-        json_object_object_add(json, "x", json_object_new_double(x));
-    }
-
-    error = NULL;
-    double y = g_key_file_get_double(info_file, "Plugin", "y", &error);
-    if (error) {
-        json_object_object_add(json, "y", json_object_new_object());
-        g_error_free(error);
-    } else {
-        json_object_object_add(json, "y", json_object_new_double(y));
-    }
-
-    char* type = g_key_file_get_string(info_file, "Plugin", "type", NULL);
-    json_object_object_add(json, "type", json_object_new_string(type == NULL ? "" : type));
-    g_free(type);
-
-    char* author = g_key_file_get_string(info_file, "Author", "author", NULL);
-    json_object_object_add(json, "author", json_object_new_string(author == NULL ? "" : author));
-    g_free(author);
-
-    char* email = g_key_file_get_string(info_file, "Author", "email", NULL);
-    json_object_object_add(json, "email", json_object_new_string(email == NULL ? "" : email));
-    g_free(email);
-
-    char* textdomain = g_key_file_get_string(info_file, "Locale", "textdomain", NULL);
-    json_object_object_add(json, "textdomain", json_object_new_string(textdomain == NULL ? "" : textdomain));
-    g_free(textdomain);
-
-    gsize length = 0;
-    char** js = g_key_file_get_string_list(info_file, "Resource", "js", &length, NULL);
-    json_object* js_arr = json_object_new_array();
-    int i;
-    for (i = 0; i < length; ++i)
-      json_object_array_add(js_arr, json_object_new_string(js[i]));
-    json_object_object_add(json, "js", js_arr);
-    g_strfreev(js);
-
-    char** css = g_key_file_get_string_list(info_file, "Resource", "css", &length, NULL);
-    json_object* css_arr = json_object_new_array();
-    for (i = 0; i < length; ++i)
-      json_object_array_add(css_arr, json_object_new_string(css[i]));
-    json_object_object_add(json, "css", css_arr);
-    g_strfreev(css);
-
-    char** screenshot = g_key_file_get_string_list(info_file, "Resource", "screenshot", &length, NULL);
-    json_object* ss_arr = json_object_new_array();
-    for (i = 0; i < length; ++i)
-      json_object_array_add(ss_arr, json_object_new_string(screenshot[i]));
-    json_object_object_add(json, "screenshot", ss_arr);
-    g_strfreev(screenshot);
-
-    g_key_file_free(info_file);
-
-    return json;
+    return plugin_registry_get_info(path);
 }
 
 
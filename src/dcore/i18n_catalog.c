@@ -0,0 +1,240 @@
+/**
+ * Copyright (c) 2011 ~ 2012 Deepin, Inc.
+ *               2011 ~ 2012 snyh
+ *
+ * Author:      snyh <snyh@snyh.org>
+ * Maintainer:  snyh <snyh@snyh.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ **/
+#include <sys/stat.h>
+#include <string.h>
+
+#include <glib.h>
+#include <libintl.h>
+
+#include "common/config.h"
+#include "json-c/json.h"
+
+/*
+ * Export a whole gettext catalog to JS at once, so the UI doesn't need a
+ * sync round trip for every translated string. The .mo file of the current
+ * locale is parsed once; the cached table is rebuilt when the domain is bound
+ * to another directory, the locale changes or the file is modified.
+ */
+
+#define MO_MAGIC 0x950412de
+#define MO_MAGIC_SWAPPED 0xde120495
+
+typedef struct _Catalog {
+    char* mo_path;
+    time_t mtime;
+    off_t size;
+    json_object* messages;
+} Catalog;
+
+/* domain -> Catalog */
+static GHashTable* _catalogs = NULL;
+
+
+static
+void _catalog_free(Catalog* catalog)
+{
+    g_free(catalog->mo_path);
+    if (catalog->messages != NULL)
+        json_object_put(catalog->messages);
+    g_slice_free(Catalog, catalog);
+}
+
+
+/*
+ * Find the .mo file gettext would use for @domain, trying the languages from
+ * LANGUAGE, LC_ALL, LC_MESSAGES and LANG in order.
+ */
+static
+char* _find_mo_file(char const* domain, struct stat* st)
+{
+    char const* dir = bindtextdomain(domain, NULL);
+    if (dir == NULL)
+        return NULL;
+
+    char* mo_name = g_strconcat(domain, ".mo", NULL);
+    char* path = NULL;
+    char const* const* languages = g_get_language_names();
+    for (int i = 0; languages[i] != NULL && path == NULL; ++i) {
+        if (g_strcmp0(languages[i], "C") == 0 || g_strcmp0(languages[i], "POSIX") == 0)
+            break;
+
+        char* candidate = g_build_filename(dir, languages[i], "LC_MESSAGES", mo_name, NULL);
+        if (stat(candidate, st) == 0 && S_ISREG(st->st_mode))
+            path = candidate;
+        else
+            g_free(candidate);
+    }
+    g_free(mo_name);
+
+    return path;
+}
+
+
+static
+guint32 _read_u32(guchar const* data, gboolean swapped)
+{
+    guint32 value;
+    memcpy(&value, data, sizeof(value));
+    return swapped ? GUINT32_SWAP_LE_BE(value) : value;
+}
+
+
+/*
+ * Get the string at table @index as (pointer, length), checking it is inside
+ * the file.
+ */
+static
+gboolean _get_string(guchar const* data, gsize size, guint32 table, guint32 index,
+                     gboolean swapped, char const** str, guint32* len)
+{
+    gsize entry = (gsize)table + (gsize)index * 8;
+    if (entry + 8 > size)
+        return FALSE;
+
+    *len = _read_u32(data + entry, swapped);
+    guint32 offset = _read_u32(data + entry + 4, swapped);
+    if ((gsize)offset + *len >= size)
+        return FALSE;
+
+    *str = (char const*)data + offset;
+    return TRUE;
+}
+
+
+static
+char* _get_charset(char const* header)
+{
+    char const* charset = strstr(header, "charset=");
+    if (charset == NULL)
+        return NULL;
+
+    charset += strlen("charset=");
+    gsize len = strcspn(charset, " \t\n;");
+    return g_strndup(charset, len);
+}
+
+
+/*
+ * Build { msgid: msgstr } from the .mo file, keeping the singular form of
+ * plural messages and dropping the ones with a context, like gettext() would
+ * return them.
+ */
+static
+json_object* _parse_mo_file(char const* path)
+{
+    gchar* data = NULL;
+    gsize size = 0;
+    json_object* messages = json_object_new_object();
+
+    if (!g_file_get_contents(path, &data, &size, NULL))
+        return messages;
+
+    guchar const* bytes = (guchar const*)data;
+    if (size < 20)
+        goto out;
+
+    guint32 magic = _read_u32(bytes, FALSE);
+    if (magic != MO_MAGIC && magic != MO_MAGIC_SWAPPED) {
+        g_warning("[%s] %s is not a mo file", __func__, path);
+        goto out;
+    }
+    gboolean swapped = magic == MO_MAGIC_SWAPPED;
+    guint32 count = _read_u32(bytes + 8, swapped);
+    guint32 orig_table = _read_u32(bytes + 12, swapped);
+    guint32 trans_table = _read_u32(bytes + 16, swapped);
+
+    char* charset = NULL;
+    for (guint32 i = 0; i < count; ++i) {
+        char const* msgid = NULL;
+        char const* msgstr = NULL;
+        guint32 msgid_len = 0;
+        guint32 msgstr_len = 0;
+        if (!_get_string(bytes, size, orig_table, i, swapped, &msgid, &msgid_len)
+            || !_get_string(bytes, size, trans_table, i, swapped, &msgstr, &msgstr_len))
+            break;
+
+        // the header is the translation of the empty msgid.
+        if (msgid_len == 0) {
+            g_free(charset);
+            charset = _get_charset(msgstr);
+            continue;
+        }
+
+        if (msgstr_len == 0 || memchr(msgid, '\004', msgid_len) != NULL)
+            continue;
+
+        // msgid and msgstr are NUL terminated in the file, plural forms are
+        // separated by NUL too so these are the singular forms.
+        if (charset == NULL || g_ascii_strcasecmp(charset, "UTF-8") == 0) {
+            if (g_utf8_validate(msgstr, -1, NULL))
+                json_object_object_add(messages, msgid, json_object_new_string(msgstr));
+        } else {
+            char* converted = g_convert(msgstr, -1, "UTF-8", charset, NULL, NULL, NULL);
+            if (converted != NULL)
+                json_object_object_add(messages, msgid, json_object_new_string(converted));
+            g_free(converted);
+        }
+    }
+    g_free(charset);
+
+out:
+    g_free(data);
+    return messages;
+}
+
+
+JS_EXPORT_API
+json_object* dcore_get_catalog(char const* domain)
+{
+    if (domain == NULL || domain[0] == '\0')
+        domain = textdomain(NULL);
+
+    if (_catalogs == NULL)
+        _catalogs = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+                                          (GDestroyNotify)_catalog_free);
+
+    struct stat st;
+    char* mo_path = _find_mo_file(domain, &st);
+
+    Catalog* catalog = g_hash_table_lookup(_catalogs, domain);
+    if (catalog != NULL && g_strcmp0(catalog->mo_path, mo_path) == 0
+        && (mo_path == NULL || (catalog->mtime == st.st_mtime && catalog->size == st.st_size))) {
+        g_free(mo_path);
+        return json_object_get(catalog->messages);
+    }
+
+    catalog = g_slice_new0(Catalog);
+    catalog->mo_path = mo_path;
+    if (mo_path != NULL) {
+        catalog->mtime = st.st_mtime;
+        catalog->size = st.st_size;
+        catalog->messages = _parse_mo_file(mo_path);
+        g_debug("[%s] load %d messages of %s from %s", __func__,
+                json_object_object_length(catalog->messages), domain, mo_path);
+    } else {
+        // no translation, JS falls back to the msgid.
+        catalog->messages = json_object_new_object();
+    }
+    g_hash_table_replace(_catalogs, g_strdup(domain), catalog);
+
+    return json_object_get(catalog->messages);
+}
+
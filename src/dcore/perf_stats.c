@@ -0,0 +1,159 @@
+/**
+ * Copyright (c) 2011 ~ 2012 Deepin, Inc.
+ *               2011 ~ 2012 snyh
+ *
+ * Author:      snyh <snyh@snyh.org>
+ * Maintainer:  snyh <snyh@snyh.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ **/
+#include <string.h>
+
+#include <glib.h>
+
+#include "common/config.h"
+#include "perf_stats.h"
+
+/*
+ * Performance counters of the modules, collected in one place so the numbers
+ * before and after a change can be compared as JSON:
+ *
+ *   DDE_PERF_DUMP=path        write the stats to path when DCore shuts down.
+ *   DDE_PERF_THRESHOLDS=path  a key file of upper limits, one group per module
+ *                             ("[dock-region]\nshape_requests=100"); stats
+ *                             above their limit are listed in "regressions".
+ *
+ * Modules in other libraries register from a constructor and must unregister
+ * from a destructor, so no collector outlives its library.
+ */
+
+typedef struct _PerfCollector {
+    char* name;
+    PerfStatsCollector collect;
+} PerfCollector;
+
+static GArray* _collectors = NULL;
+static GKeyFile* _thresholds = NULL;
+
+
+void perf_stats_register(const char* name, PerfStatsCollector collector)
+{
+    if (_collectors == NULL)
+        _collectors = g_array_new(FALSE, FALSE, sizeof(PerfCollector));
+
+    PerfCollector c = { g_strdup(name), collector };
+    g_array_append_val(_collectors, c);
+}
+
+
+void perf_stats_unregister(const char* name)
+{
+    for (guint i = 0; _collectors != NULL && i < _collectors->len; ++i) {
+        PerfCollector* c = &g_array_index(_collectors, PerfCollector, i);
+        if (strcmp(c->name, name) == 0) {
+            g_free(c->name);
+            g_array_remove_index(_collectors, i);
+            return;
+        }
+    }
+}
+
+
+static GKeyFile* _get_thresholds()
+{
+    const char* path = g_getenv("DDE_PERF_THRESHOLDS");
+    if (_thresholds == NULL && path != NULL) {
+        _thresholds = g_key_file_new();
+        GError* error = NULL;
+        if (!g_key_file_load_from_file(_thresholds, path, G_KEY_FILE_NONE, &error)) {
+            g_warning("[%s] load %s failed: %s", __func__, path, error->message);
+            g_error_free(error);
+        }
+    }
+    return _thresholds;
+}
+
+
+static void _check_thresholds(const char* name, json_object* stats, json_object* regressions)
+{
+    GKeyFile* thresholds = _get_thresholds();
+    if (thresholds == NULL || !g_key_file_has_group(thresholds, name))
+        return;
+
+    json_object_object_foreach(stats, key, value) {
+        if (!json_object_is_type(value, json_type_int) && !json_object_is_type(value, json_type_double))
+            continue;
+
+        GError* error = NULL;
+        double max = g_key_file_get_double(thresholds, name, key, &error);
+        if (error != NULL) {
+            g_error_free(error);
+            continue;
+        }
+
+        double current = json_object_get_double(value);
+        if (current > max) {
+            g_warning("[perf] %s.%s is %g, over its threshold %g", name, key, current, max);
+            json_object* regression = json_object_new_object();
+            json_object_object_add(regression, "module", json_object_new_string(name));
+            json_object_object_add(regression, "stat", json_object_new_string(key));
+            json_object_object_add(regression, "value", json_object_new_double(current));
+            json_object_object_add(regression, "threshold", json_object_new_double(max));
+            json_object_array_add(regressions, regression);
+        }
+    }
+}
+
+
+json_object* perf_stats_collect()
+{
+    json_object* result = json_object_new_object();
+    json_object* regressions = json_object_new_array();
+
+    for (guint i = 0; _collectors != NULL && i < _collectors->len; ++i) {
+        PerfCollector* c = &g_array_index(_collectors, PerfCollector, i);
+        json_object* stats = json_object_new_object();
+        c->collect(stats);
+        _check_thresholds(c->name, stats, regressions);
+        json_object_object_add(result, c->name, stats);
+    }
+
+    json_object_object_add(result, "regressions", regressions);
+    return result;
+}
+
+
+void perf_stats_dump()
+{
+    const char* path = g_getenv("DDE_PERF_DUMP");
+    if (path == NULL)
+        return;
+
+    json_object* stats = perf_stats_collect();
+    const char* content = json_object_to_json_string(stats);
+
+    GError* error = NULL;
+    if (!g_file_set_contents(path, content, -1, &error)) {
+        g_warning("[%s] write %s failed: %s", __func__, path, error->message);
+        g_error_free(error);
+    }
+    json_object_put(stats);
+}
+
+
+JS_EXPORT_API
+json_object* dcore_get_perf_stats()
+{
+    return perf_stats_collect();
+}
@@ -0,0 +1,19 @@
+#ifndef _PERF_STATS_H_
+#define _PERF_STATS_H_
+
+#include <glib.h>
+#include "json-c/json.h"
+
+// add the current numbers of a module to @stats, e.g. "requests": 10.
+typedef void (*PerfStatsCollector)(json_object* stats);
+
+void perf_stats_register(const char* name, PerfStatsCollector collector);
+void perf_stats_unregister(const char* name);
+
+// a new object: { name: { stat: value }, "regressions": [...] }
+json_object* perf_stats_collect();
+
+// write perf_stats_collect to $DDE_PERF_DUMP if it is set.
+void perf_stats_dump();
+
+#endif
@@ -0,0 +1,336 @@
+/**
+ * Copyright (c) 2011 ~ 2012 Deepin, Inc.
+ *               2011 ~ 2012 snyh
+ *
+ * Author:      snyh <snyh@snyh.org>
+ * Maintainer:  snyh <snyh@snyh.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ **/
+#include <glib.h>
+#include <gio/gio.h>
+
+#include "common/config.h"
+#include "plugin_registry.h"
+
+/*
+ * The plugins of an app live in RESOURCE_DIR/<app>/plugin and
+ * ~/.dde-plugin/<app>/plugin, one directory with an info.ini per plugin.
+ * They are scanned once, and the directories (and every plugin directory)
+ * are watched so the scan and the parsed info.ini are only redone after
+ * something changed on disk.
+ */
+
+typedef struct _PluginEntry {
+    char* id; // <app>:<plugin dir name>
+    char* js_path;
+} PluginEntry;
+
+typedef struct _AppPlugins {
+    char* app_name;
+    GPtrArray* plugins; // PluginEntry*, NULL when a rescan is needed
+    json_object* enabled; // cached result of plugin_registry_get_plugins
+    GPtrArray* monitors;
+} AppPlugins;
+
+/* app name -> AppPlugins */
+static GHashTable* _apps = NULL;
+/* plugin directory -> parsed info.ini */
+static GHashTable* _infos = NULL;
+/* plugin directories found by the scans, only their info is cached */
+static GHashTable* _known_paths = NULL;
+
+
+static
+void _plugin_entry_free(PluginEntry* entry)
+{
+    g_free(entry->id);
+    g_free(entry->js_path);
+    g_slice_free(PluginEntry, entry);
+}
+
+
+static
+void _invalidate(AppPlugins* app)
+{
+    if (app->plugins != NULL) {
+        g_ptr_array_unref(app->plugins);
+        app->plugins = NULL;
+    }
+    if (app->enabled != NULL) {
+        json_object_put(app->enabled);
+        app->enabled = NULL;
+    }
+}
+
+
+static
+void _app_plugins_free(AppPlugins* app)
+{
+    _invalidate(app);
+    g_ptr_array_unref(app->monitors);
+    g_free(app->app_name);
+    g_slice_free(AppPlugins, app);
+}
+
+
+static
+void _plugin_dir_changed(GFileMonitor* monitor G_GNUC_UNUSED,
+                         GFile* file G_GNUC_UNUSED,
+                         GFile* other_file G_GNUC_UNUSED,
+                         GFileMonitorEvent event_type,
+                         AppPlugins* app)
+{
+    if (event_type == G_FILE_MONITOR_EVENT_ATTRIBUTE_CHANGED)
+        return;
+
+    g_debug("[%s] plugins of %s changed", __func__, app->app_name);
+    // the monitors are recreated by the next scan, not from their own
+    // callback.
+    _invalidate(app);
+    if (_infos != NULL)
+        g_hash_table_remove_all(_infos);
+}
+
+
+static
+void _watch(AppPlugins* app, char const* path)
+{
+    GFile* dir = g_file_new_for_path(path);
+    GFileMonitor* monitor = g_file_monitor_directory(dir, G_FILE_MONITOR_NONE, NULL, NULL);
+    g_object_unref(dir);
+
+    if (monitor != NULL) {
+        g_signal_connect(monitor, "changed", G_CALLBACK(_plugin_dir_changed), app);
+        g_ptr_array_add(app->monitors, monitor);
+    }
+}
+
+
+static
+void _scan_plugin_dir(AppPlugins* app, char const* path)
+{
+    _watch(app, path);
+
+    GDir* dir = g_dir_open(path, 0, NULL);
+    if (dir == NULL)
+        return;
+
+    const char* file_name = NULL;
+    while ((file_name = g_dir_read_name(dir)) != NULL) {
+        char* full_path = g_build_filename(path, file_name, NULL);
+        char* info_path = g_build_filename(full_path, "info.ini", NULL);
+
+        if (g_file_test(full_path, G_FILE_TEST_IS_DIR) &&
+            g_file_test(info_path, G_FILE_TEST_EXISTS)) {
+            char* js_name = g_strconcat(file_name, ".js", NULL);
+
+            PluginEntry* entry = g_slice_new(PluginEntry);
+            entry->id = g_strconcat(app->app_name, ":", file_name, NULL);
+            entry->js_path = g_build_filename(full_path, js_name, NULL);
+            g_ptr_array_add(app->plugins, entry);
+            g_free(js_name);
+
+            _watch(app, full_path);
+            g_hash_table_add(_known_paths, g_strdup(full_path));
+        }
+
+        g_free(info_path);
+        g_free(full_path);
+    }
+
+    g_dir_close(dir);
+}
+
+
+static
+AppPlugins* _get_app_plugins(const char* app_name)
+{
+    if (_apps == NULL) {
+        _apps = g_hash_table_new_full(g_str_hash, g_str_equal, NULL,
+                                      (GDestroyNotify)_app_plugins_free);
+        _known_paths = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    }
+
+    AppPlugins* app = g_hash_table_lookup(_apps, app_name);
+    if (app == NULL) {
+        app = g_slice_new0(AppPlugins);
+        app->app_name = g_strdup(app_name);
+        app->monitors = g_ptr_array_new_with_free_func(g_object_unref);
+        g_hash_table_insert(_apps, app->app_name, app);
+    }
+
+    if (app->plugins == NULL) {
+        app->plugins = g_ptr_array_new_with_free_func((GDestroyNotify)_plugin_entry_free);
+        g_ptr_array_set_size(app->monitors, 0);
+
+        char* path = g_build_filename(RESOURCE_DIR, app_name, "plugin", NULL);
+        _scan_plugin_dir(app, path);
+        g_free(path);
+
+        path = g_build_filename(g_get_home_dir(), ".dde-plugin", app_name, "plugin", NULL);
+        _scan_plugin_dir(app, path);
+        g_free(path);
+    }
+
+    return app;
+}
+
+
+/*
+ * Return the js paths of the enabled plugins of @app_name.
+ */
+json_object* plugin_registry_get_plugins(const char* app_name, GHashTable* enabled_plugins)
+{
+    AppPlugins* app = _get_app_plugins(app_name);
+
+    if (app->enabled == NULL) {
+        app->enabled = json_object_new_array();
+        for (guint i = 0; i < app->plugins->len; ++i) {
+            PluginEntry* entry = g_ptr_array_index(app->plugins, i);
+            if (enabled_plugins != NULL && g_hash_table_contains(enabled_plugins, entry->id))
+                json_object_array_add(app->enabled, json_object_new_string(entry->js_path));
+        }
+    }
+
+    return json_object_get(app->enabled);
+}
+
+
+void plugin_registry_enabled_changed()
+{
+    if (_apps == NULL)
+        return;
+
+    GHashTableIter iter;
+    gpointer value = NULL;
+    g_hash_table_iter_init(&iter, _apps);
+    while (g_hash_table_iter_next(&iter, NULL, &value)) {
+        AppPlugins* app = value;
+        if (app->enabled != NULL) {
+            json_object_put(app->enabled);
+            app->enabled = NULL;
+        }
+    }
+}
+
+
+static
+json_object* _parse_plugin_info(char const* path)
+{
+    char* info_file_path = g_build_filename(path, "info.ini", NULL);
+    GKeyFile* info_file = g_key_file_new();
+    g_key_file_load_from_file(info_file, info_file_path, G_KEY_FILE_NONE, NULL);
+    g_free(info_file_path);
+
+    json_object* json = json_object_new_object();
+    char* id = g_key_file_get_string(info_file, "Plugin", "ID", NULL);
+    json_object_object_add(json, "ID", json_object_new_string(id == NULL ? "" : id));
+    g_free(id);
+
+    char* name = g_key_file_get_string(info_file, "Plugin", "name", NULL);
+    json_object_object_add(json, "name", json_object_new_string(name == NULL ? "" : name));
+    g_free(name);
+
+    char* description = g_key_file_get_string(info_file, "Plugin", "description", NULL);
+    json_object_object_add(json, "description", json_object_new_string(description == NULL ? "" : description));
+    g_free(description);
+
+    int width = g_key_file_get_integer(info_file, "Plugin", "width", NULL);
+    json_object_object_add(json, "width", json_object_new_int(width));
+
+    int height = g_key_file_get_integer(info_file, "Plugin", "height", NULL);
+    json_object_object_add(json, "height", json_object_new_int(height));
+
+    GError* error = NULL;
+    double x = g_key_file_get_double(info_file, "Plugin", "x", &error);
+    if (error) {
+        json_object_object_add(json, "x", json_object_new_object());
+        g_error_free(error);
+    } else {
+        json_object_object_add(json, "x", json_object_new_double(x));
+    }
+
+    error = NULL;
+    double y = g_key_file_get_double(info_file, "Plugin", "y", &error);
+    if (error) {
+        json_object_object_add(json, "y", json_object_new_object());
+        g_error_free(error);
+    } else {
+        json_object_object_add(json, "y", json_object_new_double(y));
+    }
+
+    char* type = g_key_file_get_string(info_file, "Plugin", "type", NULL);
+    json_object_object_add(json, "type", json_object_new_string(type == NULL ? "" : type));
+    g_free(type);
+
+    char* author = g_key_file_get_string(info_file, "Author", "author", NULL);
+    json_object_object_add(json, "author", json_object_new_string(author == NULL ? "" : author));
+    g_free(author);
+
+    char* email = g_key_file_get_string(info_file, "Author", "email", NULL);
+    json_object_object_add(json, "email", json_object_new_string(email == NULL ? "" : email));
+    g_free(email);
+
+    char* textdomain = g_key_file_get_string(info_file, "Locale", "textdomain", NULL);
+    json_object_object_add(json, "textdomain", json_object_new_string(textdomain == NULL ? "" : textdomain));
+    g_free(textdomain);
+
+    gsize length = 0;
+    char** js = g_key_file_get_string_list(info_file, "Resource", "js", &length, NULL);
+    json_object* js_arr = json_object_new_array();
+    gsize i;
+    for (i = 0; i < length; ++i)
+      json_object_array_add(js_arr, json_object_new_string(js[i]));
+    json_object_object_add(json, "js", js_arr);
+    g_strfreev(js);
+
+    char** css = g_key_file_get_string_list(info_file, "Resource", "css", &length, NULL);
+    json_object* css_arr = json_object_new_array();
+    for (i = 0; i < length; ++i)
+      json_object_array_add(css_arr, json_object_new_string(css[i]));
+    json_object_object_add(json, "css", css_arr);
+    g_strfreev(css);
+
+    char** screenshot = g_key_file_get_string_list(info_file, "Resource", "screenshot", &length, NULL);
+    json_object* ss_arr = json_object_new_array();
+    for (i = 0; i < length; ++i)
+      json_object_array_add(ss_arr, json_object_new_string(screenshot[i]));
+    json_object_object_add(json, "screenshot", ss_arr);
+    g_strfreev(screenshot);
+
+    g_key_file_free(info_file);
+
+    return json;
+}
+
+
+json_object* plugin_registry_get_info(const char* path)
+{
+    if (_known_paths == NULL || !g_hash_table_contains(_known_paths, path))
+        return _parse_plugin_info(path);
+
+    if (_infos == NULL)
+        _infos = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+                                       (GDestroyNotify)json_object_put);
+
+    json_object* info = g_hash_table_lookup(_infos, path);
+    if (info == NULL) {
+        info = _parse_plugin_info(path);
+        g_hash_table_insert(_infos, g_strdup(path), info);
+    }
+
+    return json_object_get(info);
+}
+
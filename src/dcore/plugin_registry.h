@@ -0,0 +1,14 @@
+#ifndef _PLUGIN_REGISTRY_H_
+#define _PLUGIN_REGISTRY_H_
+
+#include <glib.h>
+#include "json-c/json.h"
+
+// both return a new reference of a cached object, don't modify it.
+json_object* plugin_registry_get_plugins(const char* app_name, GHashTable* enabled_plugins);
+json_object* plugin_registry_get_info(const char* path);
+
+// drop the cached plugin lists after the enabled plugins changed.
+void plugin_registry_enabled_changed();
+
+#endif
@@ -19,6 +19,7 @@
  * along with this program; if not, see <http://www.gnu.org/licenses/>.
  **/
 #include "signal.h"
+#include "perf_stats.h"
 
 #include <glib.h>
 
@@ -26,82 +27,479 @@
 #include "XW_Extension.h"
 
 #include <stdio.h>
+#include <string.h>
+#include <math.h>
 
+/*
+ * Signals are delivered through lanes. High priority signals are posted at
+ * once, the others are queued per instance and flushed from an idle source,
+ * so everything posted within one main loop iteration goes out as a single
+ * {"batch": [...]} message. The normal lane is always flushed before the bulk
+ * lane, and the bulk lane sends at most SIGNAL_BULK_BATCH_MAX messages per
+ * iteration, so bursts of file events can't starve the UI signals.
+ */
+typedef enum {
+    SIGNAL_LANE_NORMAL,
+    SIGNAL_LANE_BULK,
+    SIGNAL_LANE_N,
+    SIGNAL_LANE_HIGH = SIGNAL_LANE_N,
+} SignalLane;
+
+#define SIGNAL_BULK_BATCH_MAX 256
+
+static const char* high_priority_signals[] = {
+    "get_focus", "lost_focus", "workarea_changed", "im_commit",
+    "launcher_shown", "exit_launcher", "launcher_destroy",
+};
+static const char* bulk_signals[] = {
+    "item_update", "item_delete", "item_rename", "trash_count_changed",
+    "cut_completed",
+};
+
+typedef struct _SignalMessage {
+    gint ref_count;
+    gint64 time;
+    char data[];
+} SignalMessage;
+
+typedef struct _InstanceQueue {
+    XW_Instance instance;
+    GQueue lanes[SIGNAL_LANE_N];
+} InstanceQueue;
+
+static struct {
+    guint pending;
+    guint max_pending;
+    guint64 delivered;
+    guint64 posts;
+    gint64 total_latency;
+    gint64 max_latency;
+} queue_stats;
+
+/* signal name -> GArray of the XW_Instances connected to it */
 static GHashTable* signals = NULL;
+/* signal name -> SignalLane + 1 */
+static GHashTable* signal_lanes = NULL;
+/* XW_Instance -> InstanceQueue */
+static GHashTable* queues = NULL;
+static guint flush_id = 0;
+
+/* the buffer js_signal_* build into, and the signal being built */
+static GString* signal_buffer = NULL;
+static const char* signal_building = NULL;
+static gboolean signal_has_field = FALSE;
 
 extern const XW_MessagingInterface* async_messaging_interface;
 
-void js_post_message(const char* name, json_object* json)
+
+static
+void _append_json_string(GString* buf, const char* str)
 {
-    if (signals == NULL) {
-        g_warning("signals %s has not init!\n", name);
-        return;
+    static const char hex[] = "0123456789abcdef";
+
+    g_string_append_c(buf, '"');
+    for (const guchar* p = (const guchar*)str; *p != '\0'; ++p) {
+        switch (*p) {
+        case '"': g_string_append(buf, "\\\""); break;
+        case '\\': g_string_append(buf, "\\\\"); break;
+        case '\b': g_string_append(buf, "\\b"); break;
+        case '\f': g_string_append(buf, "\\f"); break;
+        case '\n': g_string_append(buf, "\\n"); break;
+        case '\r': g_string_append(buf, "\\r"); break;
+        case '\t': g_string_append(buf, "\\t"); break;
+        default:
+            if (*p < 0x20) {
+                g_string_append(buf, "\\u00");
+                g_string_append_c(buf, hex[*p >> 4]);
+                g_string_append_c(buf, hex[*p & 0xf]);
+            } else {
+                g_string_append_c(buf, *p);
+            }
+        }
     }
+    g_string_append_c(buf, '"');
+}
 
-    //JSContextRef ctx = get_global_context();
-    //g_return_if_fail(ctx != NULL);
-    //JSObjectRef cb = g_hash_table_lookup(signals, name);
-    JSCallback* cb = g_hash_table_lookup(signals, name);
-
-    if (cb != NULL) {
-        //Call* call = g_new0(Call, 1);
-        //call->cb = cb;
-        //call->arg = json;
-	//JSValueProtect(ctx, json);
-        //g_main_context_invoke(NULL, (GSourceFunc)_interal_call, call);
-      struct json_object* ret = json_object_new_object();
-      json_object_object_add(ret, "signal", json_object_new_string(name));
-      json_object_object_add(ret, "data", json);
-      async_messaging_interface->PostMessage(cb->xw_instance, json_object_to_json_string(ret));
-    } else {
-        g_warning("signal %s has not connected!\n", name);
+
+static
+SignalLane _get_lane(const char* name)
+{
+    if (signal_lanes == NULL) {
+        signal_lanes = g_hash_table_new(g_str_hash, g_str_equal);
+        for (guint i = 0; i < G_N_ELEMENTS(high_priority_signals); ++i)
+            g_hash_table_insert(signal_lanes, (gpointer)high_priority_signals[i],
+                                GINT_TO_POINTER(SIGNAL_LANE_HIGH + 1));
+        for (guint i = 0; i < G_N_ELEMENTS(bulk_signals); ++i)
+            g_hash_table_insert(signal_lanes, (gpointer)bulk_signals[i],
+                                GINT_TO_POINTER(SIGNAL_LANE_BULK + 1));
     }
+
+    gint lane = GPOINTER_TO_INT(g_hash_table_lookup(signal_lanes, name));
+    return lane == 0 ? SIGNAL_LANE_NORMAL : (SignalLane)(lane - 1);
 }
 
+
 static
-void js_post_message_simply(const char* name, const char* format, ...)
+void _message_unref(SignalMessage* msg)
 {
-    if (format == NULL) {
-        js_post_message(name, NULL);
-    } else {
-        va_list args;
-        va_start(args, format);
-        char* json_str = g_strdup_vprintf(format, args);
-        va_end(args);
+    if (--msg->ref_count == 0)
+        g_free(msg);
+}
+
 
-        js_post_message(name, json_tokener_parse(json_str));
-        g_free(json_str);
+static
+void _free_queue(gpointer data)
+{
+    InstanceQueue* q = data;
+    for (int lane = 0; lane < SIGNAL_LANE_N; ++lane) {
+        queue_stats.pending -= g_queue_get_length(&q->lanes[lane]);
+        SignalMessage* msg = NULL;
+        while ((msg = g_queue_pop_head(&q->lanes[lane])) != NULL)
+            _message_unref(msg);
     }
+    g_slice_free(InstanceQueue, q);
 }
 
+
+static
+InstanceQueue* _get_queue(XW_Instance instance)
+{
+    if (queues == NULL)
+        queues = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, _free_queue);
+
+    InstanceQueue* q = g_hash_table_lookup(queues, GINT_TO_POINTER(instance));
+    if (q == NULL) {
+        q = g_slice_new0(InstanceQueue);
+        q->instance = instance;
+        for (int lane = 0; lane < SIGNAL_LANE_N; ++lane)
+            g_queue_init(&q->lanes[lane]);
+        g_hash_table_insert(queues, GINT_TO_POINTER(instance), q);
+    }
+    return q;
+}
+
+
+/*
+ * Post up to @max messages of @lane as one message, return whether there
+ * are messages left.
+ */
+static
+gboolean _flush_lane(InstanceQueue* q, SignalLane lane, guint max)
+{
+    GQueue* pending = &q->lanes[lane];
+    guint n = MIN(g_queue_get_length(pending), max);
+    if (n == 0)
+        return FALSE;
+
+    gint64 now = g_get_monotonic_time();
+    GString* batch = NULL;
+    SignalMessage* msg = g_queue_peek_head(pending);
+    if (n > 1) {
+        batch = g_string_new("{\"batch\":[");
+        for (guint i = 0; i < n; ++i) {
+            msg = g_queue_peek_nth(pending, i);
+            if (i != 0)
+                g_string_append_c(batch, ',');
+            g_string_append(batch, msg->data);
+        }
+        g_string_append(batch, "]}");
+    }
+
+    async_messaging_interface->PostMessage(q->instance, batch ? batch->str : msg->data);
+    if (batch != NULL)
+        g_string_free(batch, TRUE);
+
+    for (guint i = 0; i < n; ++i) {
+        msg = g_queue_pop_head(pending);
+        gint64 latency = now - msg->time;
+        queue_stats.total_latency += latency;
+        if (latency > queue_stats.max_latency)
+            queue_stats.max_latency = latency;
+        _message_unref(msg);
+    }
+    queue_stats.pending -= n;
+    queue_stats.delivered += n;
+    queue_stats.posts++;
+
+    return !g_queue_is_empty(pending);
+}
+
+
+static
+gboolean _flush_queues(gpointer data G_GNUC_UNUSED)
+{
+    gboolean more = FALSE;
+
+    GHashTableIter iter;
+    gpointer value = NULL;
+    g_hash_table_iter_init(&iter, queues);
+    while (g_hash_table_iter_next(&iter, NULL, &value)) {
+        InstanceQueue* q = value;
+        _flush_lane(q, SIGNAL_LANE_NORMAL, G_MAXUINT);
+        more |= _flush_lane(q, SIGNAL_LANE_BULK, SIGNAL_BULK_BATCH_MAX);
+    }
+
+    if (!more)
+        flush_id = 0;
+    return more;
+}
+
+
+/*
+ * Post the serialized signal @str to every instance connected to @name.
+ */
+static
+void _post_serialized(const char* name, const char* str, gsize len)
+{
+    GArray* instances = signals != NULL ? g_hash_table_lookup(signals, name) : NULL;
+    if (instances == NULL || instances->len == 0) {
+        g_warning("signal %s has not connected!\n", name);
+        return;
+    }
+
+    SignalLane lane = _get_lane(name);
+    if (lane == SIGNAL_LANE_HIGH) {
+        for (guint i = 0; i < instances->len; ++i)
+            async_messaging_interface->PostMessage(g_array_index(instances, XW_Instance, i), str);
+        queue_stats.delivered += instances->len;
+        queue_stats.posts += instances->len;
+        return;
+    }
+
+    SignalMessage* msg = g_malloc(sizeof(SignalMessage) + len + 1);
+    msg->ref_count = instances->len;
+    msg->time = g_get_monotonic_time();
+    memcpy(msg->data, str, len + 1);
+
+    for (guint i = 0; i < instances->len; ++i) {
+        InstanceQueue* q = _get_queue(g_array_index(instances, XW_Instance, i));
+        g_queue_push_tail(&q->lanes[lane], msg);
+    }
+
+    queue_stats.pending += instances->len;
+    if (queue_stats.pending > queue_stats.max_pending)
+        queue_stats.max_pending = queue_stats.pending;
+
+    if (flush_id == 0)
+        flush_id = g_idle_add_full(G_PRIORITY_DEFAULT, _flush_queues, NULL, NULL);
+}
+
+
+/*
+ * Post @json to every instance connected to the signal @name, the ownership
+ * of @json is taken. The message is serialized once for all the instances.
+ */
+void js_post_message(const char* name, json_object* json)
+{
+    struct json_object* ret = json_object_new_object();
+    json_object_object_add(ret, "signal", json_object_new_string(name));
+    json_object_object_add(ret, "data", json);
+    const char* str = json_object_to_json_string(ret);
+    _post_serialized(name, str, strlen(str));
+    json_object_put(ret);
+}
+
+
 void js_post_signal(const char* signal)
 {
-    js_post_message_simply(signal, NULL);
+    GString* str = g_string_new("{\"signal\":");
+    _append_json_string(str, signal);
+    g_string_append(str, ",\"data\":null}");
+    _post_serialized(signal, str->str, str->len);
+    g_string_free(str, TRUE);
+}
+
+
+/*
+ * Build a signal straight into a reusable buffer, without going through a
+ * json_object:
+ *
+ *     js_signal_begin("trash_count_changed");
+ *     js_signal_add_int("value", count);
+ *     js_signal_end();
+ *
+ * posts {"signal":"trash_count_changed","data":{"value":count}}. Keys are
+ * written as is, so they must not need escaping. Only one signal can be
+ * built at a time, from the main thread.
+ */
+void js_signal_begin(const char* name)
+{
+    g_return_if_fail(signal_building == NULL);
+
+    if (signal_buffer == NULL)
+        signal_buffer = g_string_sized_new(256);
+
+    signal_building = name;
+    signal_has_field = FALSE;
+    g_string_assign(signal_buffer, "{\"signal\":");
+    _append_json_string(signal_buffer, name);
+    g_string_append(signal_buffer, ",\"data\":{");
+}
+
+
+static
+void _append_key(const char* key)
+{
+    if (signal_has_field)
+        g_string_append_c(signal_buffer, ',');
+    signal_has_field = TRUE;
+
+    g_string_append_c(signal_buffer, '"');
+    g_string_append(signal_buffer, key);
+    g_string_append(signal_buffer, "\":");
+}
+
+
+void js_signal_add_int(const char* key, gint64 value)
+{
+    g_return_if_fail(signal_building != NULL);
+    _append_key(key);
+    g_string_append_printf(signal_buffer, "%" G_GINT64_FORMAT, value);
+}
+
+
+void js_signal_add_double(const char* key, double value)
+{
+    g_return_if_fail(signal_building != NULL);
+    _append_key(key);
+    if (isfinite(value)) {
+        char buf[G_ASCII_DTOSTR_BUF_SIZE];
+        g_string_append(signal_buffer, g_ascii_dtostr(buf, sizeof(buf), value));
+    } else {
+        g_string_append(signal_buffer, "null");
+    }
+}
+
+
+void js_signal_add_boolean(const char* key, gboolean value)
+{
+    g_return_if_fail(signal_building != NULL);
+    _append_key(key);
+    g_string_append(signal_buffer, value ? "true" : "false");
 }
 
 
-void unprotect(gpointer data)
+void js_signal_add_string(const char* key, const char* value)
 {
-    //GRAB_CTX();
-    //JSContextRef ctx = get_global_context();
-    //JSValueUnprotect(ctx, (JSValueRef)data);
-    //UNGRAB_CTX();
+    g_return_if_fail(signal_building != NULL);
+    _append_key(key);
+    if (value != NULL)
+        _append_json_string(signal_buffer, value);
+    else
+        g_string_append(signal_buffer, "null");
 }
 
+
+void js_signal_end()
+{
+    g_return_if_fail(signal_building != NULL);
+    g_string_append(signal_buffer, "}}");
+    _post_serialized(signal_building, signal_buffer->str, signal_buffer->len);
+    signal_building = NULL;
+}
+
+
+static
+void _collect_queue_stats(json_object* stats)
+{
+    json_object_object_add(stats, "pending", json_object_new_int(queue_stats.pending));
+    json_object_object_add(stats, "max_pending", json_object_new_int(queue_stats.max_pending));
+    json_object_object_add(stats, "delivered", json_object_new_int64(queue_stats.delivered));
+    json_object_object_add(stats, "posts", json_object_new_int64(queue_stats.posts));
+    json_object_object_add(stats, "avg_latency_us",
+                           json_object_new_int64(queue_stats.delivered ?
+                                                 queue_stats.total_latency / (gint64)queue_stats.delivered : 0));
+    json_object_object_add(stats, "max_latency_us", json_object_new_int64(queue_stats.max_latency));
+}
+
+
+JS_EXPORT_API
+json_object* dcore_get_signal_queue_stats()
+{
+    json_object* stats = json_object_new_object();
+    _collect_queue_stats(stats);
+    return stats;
+}
+
+
+static void _register_stats() __attribute__((constructor));
+
+void _register_stats()
+{
+    perf_stats_register("signal-queue", _collect_queue_stats);
+}
+
+static
+gint _find_instance(GArray* instances, XW_Instance instance)
+{
+    for (guint i = 0; i < instances->len; ++i)
+        if (g_array_index(instances, XW_Instance, i) == instance)
+            return i;
+    return -1;
+}
+
+
+static
+void _free_instances(gpointer data)
+{
+    g_array_free((GArray*)data, TRUE);
+}
+
+
 JS_EXPORT_API
 void dcore_signal_connect(const char* type, JSCallback* value)
 {
     if (signals == NULL) {
-        signals = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, unprotect);
+        signals = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, _free_instances);
     }
-    //JSContextRef ctx = get_global_context();
-    //JSObjectRef cb = JSValueToObject(ctx, value, js->exception);
-    //if (cb != NULL || !JSObjectIsFunction(ctx, cb)) {
-        //JSValueProtect(ctx, cb);
-        g_hash_table_insert(signals, g_strdup(type), (gpointer)value);
-        /*g_message("signal connect %s \n", type);*/
-    //} else {
-    //    g_warning("signal_connect's second parameter must be an function object");
-    //}
+
+    GArray* instances = g_hash_table_lookup(signals, type);
+    if (instances == NULL) {
+        instances = g_array_new(FALSE, FALSE, sizeof(XW_Instance));
+        g_hash_table_insert(signals, g_strdup(type), instances);
+    }
+
+    // connecting twice from the same instance still delivers once.
+    if (_find_instance(instances, value->xw_instance) == -1)
+        g_array_append_val(instances, value->xw_instance);
+}
+
+
+JS_EXPORT_API
+void dcore_signal_disconnect(const char* type, JSCallback* value)
+{
+    GArray* instances = signals != NULL ? g_hash_table_lookup(signals, type) : NULL;
+    if (instances == NULL)
+        return;
+
+    gint i = _find_instance(instances, value->xw_instance);
+    if (i != -1)
+        g_array_remove_index_fast(instances, i);
+
+    if (instances->len == 0)
+        g_hash_table_remove(signals, type);
 }
 
+
+static
+gboolean _remove_instance(gpointer key G_GNUC_UNUSED, gpointer value, gpointer user_data)
+{
+    GArray* instances = value;
+    gint i = _find_instance(instances, *(XW_Instance*)user_data);
+    if (i != -1)
+        g_array_remove_index_fast(instances, i);
+    return instances->len == 0;
+}
+
+
+/*
+ * Called when a web content using DCore goes away, drop all of its
+ * connections so nothing is posted to a dead instance.
+ */
+void dcore_signal_instance_destroyed(XW_Instance instance)
+{
+    if (signals != NULL)
+        g_hash_table_foreach_remove(signals, _remove_instance, &instance);
+    if (queues != NULL)
+        g_hash_table_remove(queues, GINT_TO_POINTER(instance));
+}
@@ -1,11 +1,24 @@
 #ifndef SIGNAL_H 
 #define SIGNAL_H 
 
+#include <glib.h>
 #include "json-c/json.h"
+#include "common/config.h"
 
 void js_post_message(const char* name, json_object* json);
 
 void js_post_signal(const char* signal);
 
+void js_signal_begin(const char* name);
+void js_signal_add_int(const char* key, gint64 value);
+void js_signal_add_double(const char* key, double value);
+void js_signal_add_boolean(const char* key, gboolean value);
+void js_signal_add_string(const char* key, const char* value);
+void js_signal_end();
+
+void dcore_signal_connect(const char* type, JSCallback* value);
+void dcore_signal_disconnect(const char* type, JSCallback* value);
+void dcore_signal_instance_destroyed(XW_Instance instance);
+
 #endif /* end of include guard: SIGNAL_H */
 
@@ -0,0 +1,229 @@
+/**
+ * Copyright (c) 2011 ~ 2014 Deepin, Inc.
+ *               2011 ~ 2014 snyh
+ *
+ * Author:      snyh <snyh@snyh.org>
+ * Maintainer:  snyh <snyh@snyh.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ **/
+#include <sys/stat.h>
+#include <string.h>
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <gio/gio.h>
+
+#include "content_type_cache.h"
+
+// the cache is simply dropped when it grows over this size.
+#define CONTENT_TYPE_CACHE_MAX 4096
+
+typedef struct _ContentTypeKey {
+    dev_t dev;
+    ino_t ino;
+    time_t mtime;
+    goffset size;
+} ContentTypeKey;
+
+G_LOCK_DEFINE_STATIC(content_type_cache);
+static GHashTable* _content_type_cache = NULL;
+static GHashTable* _archive_mime_types = NULL;
+
+
+static guint _content_type_key_hash(gconstpointer v)
+{
+    ContentTypeKey const* key = v;
+    guint hash = (guint)key->ino;
+    hash = hash * 31 + (guint)key->dev;
+    hash = hash * 31 + (guint)key->mtime;
+    hash = hash * 31 + (guint)key->size;
+    return hash;
+}
+
+
+static gboolean _content_type_key_equal(gconstpointer a, gconstpointer b)
+{
+    ContentTypeKey const* ka = a;
+    ContentTypeKey const* kb = b;
+    return ka->ino == kb->ino && ka->dev == kb->dev
+        && ka->mtime == kb->mtime && ka->size == kb->size;
+}
+
+
+static const char* _query_content_type(GFile* file, GFileQueryInfoFlags flags)
+{
+    const char* content_type = NULL;
+    GFileInfo* info = g_file_query_info(file, G_FILE_ATTRIBUTE_STANDARD_CONTENT_TYPE,
+                                        flags, NULL, NULL);
+    if (info != NULL) {
+        const char* type = g_file_info_get_content_type(info);
+        if (type != NULL)
+            content_type = g_intern_string(type);
+        g_object_unref(info);
+    }
+    return content_type;
+}
+
+
+static const char* _intern_mime_type(const char* content_type)
+{
+    if (content_type == NULL)
+        return NULL;
+
+    char* mime_type = g_content_type_get_mime_type(content_type);
+    const char* interned = g_intern_string(mime_type);
+    g_free(mime_type);
+    return interned;
+}
+
+
+/*
+ * Fill @type_info with the content type, mime type and mtime of @file. The
+ * content type of native files is cached by (dev, inode, mtime, size), so a
+ * file is sniffed at most once until it is changed. The returned strings are
+ * interned, don't free them.
+ */
+gboolean gfile_query_type_info(GFile* file, GFileQueryInfoFlags flags, FileTypeInfo* type_info)
+{
+    memset(type_info, 0, sizeof(FileTypeInfo));
+
+    char* path = g_file_get_path(file);
+    GStatBuf st;
+    int stat_result = -1;
+    if (path != NULL) {
+        if (flags & G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS)
+            stat_result = g_lstat(path, &st);
+        else
+            stat_result = g_stat(path, &st);
+        g_free(path);
+    }
+
+    if (stat_result != 0) {
+        // non-native file or file has gone, ask gio directly.
+        GFileInfo* info = g_file_query_info(file, G_FILE_ATTRIBUTE_STANDARD_CONTENT_TYPE","
+                                            G_FILE_ATTRIBUTE_TIME_MODIFIED,
+                                            flags, NULL, NULL);
+        if (info == NULL)
+            return FALSE;
+
+        const char* type = g_file_info_get_content_type(info);
+        type_info->content_type = type != NULL ? g_intern_string(type) : NULL;
+        type_info->mime_type = _intern_mime_type(type_info->content_type);
+        type_info->mtime = g_file_info_get_attribute_uint64(info, G_FILE_ATTRIBUTE_TIME_MODIFIED);
+        g_object_unref(info);
+        return TRUE;
+    }
+
+    ContentTypeKey key = { st.st_dev, st.st_ino, st.st_mtime, st.st_size };
+    type_info->mtime = st.st_mtime;
+
+    G_LOCK(content_type_cache);
+    if (_content_type_cache == NULL)
+        _content_type_cache = g_hash_table_new_full(_content_type_key_hash,
+                                                    _content_type_key_equal,
+                                                    g_free, NULL);
+    type_info->content_type = g_hash_table_lookup(_content_type_cache, &key);
+    G_UNLOCK(content_type_cache);
+
+    if (type_info->content_type == NULL) {
+        type_info->content_type = _query_content_type(file, flags);
+        if (type_info->content_type == NULL)
+            return FALSE;
+
+        G_LOCK(content_type_cache);
+        if (g_hash_table_size(_content_type_cache) >= CONTENT_TYPE_CACHE_MAX)
+            g_hash_table_remove_all(_content_type_cache);
+        ContentTypeKey* cached_key = g_new(ContentTypeKey, 1);
+        *cached_key = key;
+        g_hash_table_insert(_content_type_cache, cached_key,
+                            (gpointer)type_info->content_type);
+        G_UNLOCK(content_type_cache);
+    }
+
+    type_info->mime_type = _intern_mime_type(type_info->content_type);
+    return TRUE;
+}
+
+
+const char* gfile_get_content_type(GFile* file, GFileQueryInfoFlags flags)
+{
+    FileTypeInfo type_info;
+    if (!gfile_query_type_info(file, flags, &type_info))
+        return NULL;
+    return type_info.content_type;
+}
+
+
+void content_type_cache_clear()
+{
+    G_LOCK(content_type_cache);
+    if (_content_type_cache != NULL)
+        g_hash_table_remove_all(_content_type_cache);
+    G_UNLOCK(content_type_cache);
+}
+
+
+gboolean content_type_is_archive(const char* content_type)
+{
+    static const char * archive_mime_types[] = { "application/x-gtar",
+        "application/x-zip",
+        "application/x-zip-compressed",
+        "application/zip",
+        "application/x-tar",
+        "application/x-7z-compressed",
+        "application/x-rar",
+        "application/x-rar-compressed",
+        "application/x-jar",
+        "application/x-java-archive",
+        "application/x-war",
+        "application/x-ear",
+        "application/x-arj",
+        "application/x-gzip",
+        "application/gzip",
+        "application/x-bzip-compressed-tar",
+        "application/x-compressed-tar",
+        "application/x-archive",
+        "application/x-xz-compressed-tar",
+        "application/x-bzip",
+        "application/x-cbz",
+        "application/x-xz",
+        "application/x-lzma-compressed-tar",
+        "application/x-ms-dos-executable",
+        "application/x-lzma",
+        "application/x-cd-image",
+        "application/x-deb",
+        "application/x-rpm",
+        "application/x-stuffit",
+        "application/x-tzo",
+        "application/x-tarz",
+        "application/x-msdownload",
+        "application/x-lha",
+        "application/x-zoo"};
+
+    if (content_type == NULL)
+        return FALSE;
+
+    G_LOCK(content_type_cache);
+    if (_archive_mime_types == NULL) {
+        _archive_mime_types = g_hash_table_new(g_direct_hash, g_direct_equal);
+        for (guint i = 0; i < G_N_ELEMENTS(archive_mime_types); ++i)
+            g_hash_table_add(_archive_mime_types,
+                             (gpointer)g_intern_static_string(archive_mime_types[i]));
+    }
+    G_UNLOCK(content_type_cache);
+
+    // both sides are interned, so the set only compares pointers.
+    return g_hash_table_contains(_archive_mime_types, content_type);
+}
@@ -0,0 +1,20 @@
+#ifndef _CONTENT_TYPE_CACHE_H_
+#define _CONTENT_TYPE_CACHE_H_
+
+#include <time.h>
+#include <gio/gio.h>
+
+typedef struct _FileTypeInfo {
+    const char* content_type; // interned
+    const char* mime_type; // interned
+    time_t mtime;
+} FileTypeInfo;
+
+gboolean gfile_query_type_info (GFile* file, GFileQueryInfoFlags flags, FileTypeInfo* type_info);
+const char* gfile_get_content_type (GFile* file, GFileQueryInfoFlags flags); // interned, don't free
+void content_type_cache_clear ();
+
+// @content_type must be interned, e.g. the one returned by gfile_get_content_type.
+gboolean content_type_is_archive (const char* content_type);
+
+#endif
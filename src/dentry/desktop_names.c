@@ -0,0 +1,176 @@
+/**
+ * Copyright (c) 2011 ~ 2012 Deepin, Inc.
+ *               2011 ~ 2012 snyh
+ *
+ * Author:      snyh <snyh@snyh.org>
+ * Maintainer:  snyh <snyh@snyh.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ **/
+#include <string.h>
+
+#include <glib.h>
+#include <gio/gio.h>
+
+#include "common/xdg_misc.h"
+#include "desktop_names.h"
+
+/*
+ * The desktop dir is read once into a name set, then the desktop's inotify
+ * watcher adds and removes names, so existence checks and picking the next
+ * free "Untitled(N)" name need no syscall. Without the watcher the set would
+ * go stale, so it is reread for every query until desktop_names_set_watched
+ * is called.
+ */
+
+static GHashTable* _names = NULL;
+/* "<prefix>\n<suffix>" -> the first N which may be free */
+static GHashTable* _counters = NULL;
+static gboolean _watched = FALSE;
+static gboolean _valid = FALSE;
+
+
+static
+void _load_names()
+{
+    if (_names == NULL) {
+        _names = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+        _counters = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    } else {
+        g_hash_table_remove_all(_names);
+        g_hash_table_remove_all(_counters);
+    }
+
+    GDir* dir = g_dir_open(DESKTOP_DIR(), 0, NULL);
+    if (dir != NULL) {
+        const char* name = NULL;
+        while ((name = g_dir_read_name(dir)) != NULL)
+            g_hash_table_add(_names, g_strdup(name));
+        g_dir_close(dir);
+    }
+
+    _valid = _watched;
+}
+
+
+static
+GHashTable* _get_names()
+{
+    if (!_valid)
+        _load_names();
+    return _names;
+}
+
+
+void desktop_names_set_watched(gboolean watched)
+{
+    _watched = watched;
+    _valid = FALSE;
+}
+
+
+void desktop_names_invalidate()
+{
+    _valid = FALSE;
+}
+
+
+void desktop_names_add(const char* name)
+{
+    if (_valid)
+        g_hash_table_add(_names, g_strdup(name));
+}
+
+
+void desktop_names_remove(const char* name)
+{
+    if (_valid && g_hash_table_remove(_names, name)) {
+        // a smaller N may be free now.
+        g_hash_table_remove_all(_counters);
+    }
+}
+
+
+gboolean desktop_names_contains(const char* name)
+{
+    return g_hash_table_contains(_get_names(), name);
+}
+
+
+static
+gboolean _is_desktop_dir(GFile* dir)
+{
+    char* path = g_file_get_path(dir);
+    gboolean is_desktop = g_strcmp0(path, DESKTOP_DIR()) == 0;
+    g_free(path);
+    return is_desktop;
+}
+
+
+GFile* desktop_names_get_free_child(GFile* dir, const char* first,
+                                    const char* prefix, const char* suffix)
+{
+    if (!_is_desktop_dir(dir)) {
+        GFile* child = g_file_get_child(dir, first);
+        for (int i = 0; g_file_query_exists(child, NULL) && i < 500; i++) {
+            g_object_unref(child);
+            char* name = g_strdup_printf("%s(%d)%s", prefix, i, suffix);
+            child = g_file_get_child(dir, name);
+            g_free(name);
+        }
+        return child;
+    }
+
+    // the caller is about to create the name, reserve it right away since the
+    // watcher reports the new file only on its next poll.
+    GHashTable* names = _get_names();
+    if (!g_hash_table_contains(names, first)) {
+        desktop_names_add(first);
+        return g_file_get_child(dir, first);
+    }
+
+    char* key = g_strconcat(prefix, "\n", suffix, NULL);
+    int i = GPOINTER_TO_INT(g_hash_table_lookup(_counters, key));
+    char* name = NULL;
+    for (;; ++i) {
+        name = g_strdup_printf("%s(%d)%s", prefix, i, suffix);
+        if (!g_hash_table_contains(names, name))
+            break;
+        g_free(name);
+    }
+
+    g_hash_table_insert(_counters, key, GINT_TO_POINTER(i + 1));
+    desktop_names_add(name);
+
+    GFile* child = g_file_get_child(dir, name);
+    g_free(name);
+    return child;
+}
+
+
+void desktop_names_unreserve(GFile* child)
+{
+    GFile* dir = g_file_get_parent(child);
+    if (dir == NULL)
+        return;
+
+    // a cancelled copy may still have created part of the tree, keep the
+    // name then.
+    if (_is_desktop_dir(dir) && !g_file_query_exists(child, NULL)) {
+        char* name = g_file_get_basename(child);
+        desktop_names_remove(name);
+        g_free(name);
+    }
+    g_object_unref(dir);
+}
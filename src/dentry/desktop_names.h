@@ -0,0 +1,23 @@
+#ifndef _DESKTOP_NAMES_H_
+#define _DESKTOP_NAMES_H_
+
+#include <gio/gio.h>
+
+// the names in the desktop dir, kept current by the desktop's inotify
+// watcher once desktop_names_set_watched is called.
+void desktop_names_set_watched(gboolean watched);
+void desktop_names_add(const char* name);
+void desktop_names_remove(const char* name);
+void desktop_names_invalidate();
+
+gboolean desktop_names_contains(const char* name);
+
+// the child of @dir named @first, or "<prefix>(N)<suffix>" with the smallest
+// N free. Creating the file must still fail when it exists.
+GFile* desktop_names_get_free_child(GFile* dir, const char* first,
+                                    const char* prefix, const char* suffix);
+
+// drop the name reserved for @child when creating it failed.
+void desktop_names_unreserve(GFile* child);
+
+#endif
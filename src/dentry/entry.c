@@ -36,12 +36,17 @@
 #include "fileops_trash.h"
 #include "fileops_delete.h"
 #include "thumbnails.h"
+#include "content_type_cache.h"
+#include "entry_cache.h"
+#include "desktop_names.h"
 #include "mime_actions.h"
+#include "launch_service.h"
 #include "fileops_error_reporting.h"
 
 #include "common/utils.h"
 #include "common/xdg_misc.h"
 #include "common/category.h"
+#include "common/config_store.h"
 #include "common/config.h"
 #include "dcore/dcore.h"
 #include "json-c/json.h"
@@ -50,7 +55,6 @@ ArrayContainer EMPTY_CONTAINER = {0, 0};
 
 static GFile* _get_gfile_from_gapp(GDesktopAppInfo* info);
 static ArrayContainer _normalize_array_container(ArrayContainer pfs);
-static gboolean _file_is_archive (GFile *file);
 static void _commandline_exec(const char *commandline, GList *list);
 
 
@@ -256,12 +260,23 @@ const char* dentry_get_icon(Entry* e)
 {
     char* ret = NULL;
     TEST_GFILE(e, f)
+        // regular files get their icon from the (cached) content type, others
+        // like special directories may have their own icons.
+        if (g_file_query_file_type(f, G_FILE_QUERY_INFO_NONE, NULL) == G_FILE_TYPE_REGULAR) {
+            const char* content_type = gfile_get_content_type(f, G_FILE_QUERY_INFO_NONE);
+            if (content_type != NULL) {
+                GIcon* icon = g_content_type_get_icon(content_type);
+                ret = lookup_icon_by_gicon(icon);
+                g_object_unref(icon);
+                return ret;
+            }
+        }
         GFileInfo *info = g_file_query_info(f, "standard::icon", G_FILE_QUERY_INFO_NONE, NULL, NULL);
         if (info != NULL) {
             GIcon* icon = g_file_info_get_icon(info);
             ret = lookup_icon_by_gicon(icon);
+            g_object_unref(info);
         }
-        g_object_unref(info);
     TEST_GAPP(e, app)
         GIcon *icon = g_app_info_get_icon(app);
 
@@ -359,11 +374,12 @@ const char* dentry_get_id(Entry* e)
 JS_EXPORT_API
 gboolean dentry_launch(Entry* e, const ArrayContainer fs)
 {
+    gint64 start = g_get_monotonic_time();
     TEST_GFILE(e, f)
         gboolean launch_res = TRUE;
-        GFileInfo* info = g_file_query_info(f, "standard::content-type,access::can-execute", G_FILE_QUERY_INFO_NONE, NULL, NULL);
-        if (info != NULL) {
-            const char* content_type = g_file_info_get_attribute_string(info, G_FILE_ATTRIBUTE_STANDARD_CONTENT_TYPE);
+        GFileInfo* info = g_file_query_info(f, "access::can-execute", G_FILE_QUERY_INFO_NONE, NULL, NULL);
+        const char* content_type = gfile_get_content_type(f, G_FILE_QUERY_INFO_NONE);
+        if (info != NULL && content_type != NULL) {
             gboolean is_executable = g_file_info_get_attribute_boolean(info, "access::can-execute");
             //ugly hack here. we just read the first GFile*.
             GFile* _file_arg = NULL;
@@ -388,6 +404,8 @@ gboolean dentry_launch(Entry* e, const ArrayContainer fs)
 
             g_object_unref(info);
         } else {
+            if (info != NULL)
+                g_object_unref(info);
             g_message("GFileInfo is NULL");
             char* path = g_file_get_path(f);
             run_command1("gvfs-open", path);
@@ -398,16 +416,13 @@ gboolean dentry_launch(Entry* e, const ArrayContainer fs)
     TEST_GAPP(e, app)
         char const* startup_wm_class = g_desktop_app_info_get_startup_wm_class(G_DESKTOP_APP_INFO(app));
         if (startup_wm_class != NULL) {
-            GKeyFile* f = load_app_config("dock/filter.ini");
             const char* path = g_desktop_app_info_get_filename(G_DESKTOP_APP_INFO(app));
             char* appid = get_basename_without_extend_name(path);
             g_strdelimit(appid, "_", '-');
             // g_warning("[%s] save %s", __func__, appid);
-            g_key_file_set_string(f, startup_wm_class, "appid", appid);
-            g_key_file_set_string(f, startup_wm_class, "path", path);
+            config_store_set_string("dock/filter.ini", startup_wm_class, "appid", appid);
+            config_store_set_string("dock/filter.ini", startup_wm_class, "path", path);
             g_free(appid);
-            save_app_config(f, "dock/filter.ini");
-            g_key_file_unref(f);
         }
         ArrayContainer _fs = _normalize_array_container(fs);
 
@@ -416,11 +431,7 @@ gboolean dentry_launch(Entry* e, const ArrayContainer fs)
         for (size_t i=0; i<fs.num; i++) {
             list = g_list_append(list, files[i]);
         }
-        GdkAppLaunchContext* launch_context = gdk_display_get_app_launch_context(gdk_display_get_default());
-        gdk_app_launch_context_set_screen(launch_context, gdk_screen_get_default());
-        gdk_app_launch_context_set_icon(launch_context, g_app_info_get_icon(app));
-        gboolean ret = g_app_info_launch(app, list, (GAppLaunchContext*)launch_context, NULL);
-        g_object_unref(launch_context);
+        gboolean ret = launch_service_launch_app(app, list, start);
         g_list_free(list);
 
         for (size_t i=0; i<_fs.num; i++) {
@@ -464,158 +475,182 @@ ArrayContainer dentry_list_files(GFile* f)
 JS_EXPORT_API
 Entry* dentry_create_by_path(const char* path)
 {
-    if (g_str_has_suffix(path, ".desktop")) {
-        Entry* e = g_desktop_app_info_new_from_filename(path);
-        if (e != NULL) return e;
-    }
-    return g_file_new_for_commandline_arg(path);
+    return entry_cache_lookup(path);
 }
 
+// PATH rarely changes, don't search it on every context menu.
+#define TOOL_CHECK_INTERVAL_US (60 * G_TIME_SPAN_SECOND)
+
 JS_EXPORT_API
 gboolean dentry_is_fileroller_exist()
 {
-    gchar *path = g_find_program_in_path("file-roller");
+    static gboolean exist = FALSE;
+    static gint64 checked = 0;
 
-    if(NULL != path)
-    {
+    gint64 now = g_get_monotonic_time();
+    if (checked == 0 || now - checked > TOOL_CHECK_INTERVAL_US) {
+        gchar *path = g_find_program_in_path("file-roller");
+        exist = path != NULL;
         g_free(path);
-        return TRUE;
+        checked = now;
     }
 
-    return FALSE;
+    return exist;
 }
 
-JS_EXPORT_API
-double dentry_files_compressibility(ArrayContainer fs)
+static gboolean
+_is_desktop_file (GFile *f)
 {
-    ArrayContainer _fs = {0};
-    GFile** files = NULL;
-
-    if (fs.num != 0)
-    {
-        _fs = _normalize_array_container(fs);
-        files = _fs.data;
-    }
+    char *filename = g_file_get_basename(f);
+    gboolean is_desktop = NULL != filename && g_str_has_suffix(filename, ".desktop");
+    g_free(filename);
+    return is_desktop;
+}
 
-    if(1 == fs.num)
+/*
+ * @files are normalized, i.e. no GDesktopAppInfo, @content_types[i] is the
+ * content type of @files[i], so callers which query the files anyway don't
+ * sniff them again.
+ */
+static int
+_files_compressibility (GFile** files, const char** content_types, gsize num)
+{
+    if(1 == num)
     {
         GFile *f = files[0];
-        if(_file_is_archive(f))
-        {
-            g_free(_fs.data);
+        if(content_type_is_archive(content_types[0]))
             return FILES_DECOMPRESSIBLE;
-        }
-        char *filename = g_file_get_basename(f);
-        if(NULL!=filename && g_str_has_suffix(filename, ".desktop"))
-        {
-            g_free(_fs.data);
-            g_free(filename);
+        if(_is_desktop_file(f))
             return FILES_COMPRESSIBLE_NONE;
-        }
     }
-    else if(1 < fs.num)
+    else if(1 < num)
     {
         gboolean all_compressed = TRUE;
-        for(guint i=0; i<fs.num; i++)
+        for(gsize i=0; i<num; i++)
         {
             GFile *f = files[i];
             if(NULL == f)
-            {
-                g_free(_fs.data);
                 return FILES_COMPRESSIBLE_NONE;
-            }
-            if(!_file_is_archive(f))
+
+            if(!content_type_is_archive(content_types[i]))
             {
                 all_compressed = FALSE;
-                if(!g_file_get_path(f))
-                {
-                    g_free(_fs.data);
+                char *path = g_file_get_path(f);
+                gboolean has_path = NULL != path;
+                g_free(path);
+                if(!has_path)
                     return FILES_COMPRESSIBLE_NONE;
-                }
             }
 
-            char *filename = g_file_get_basename(f);
-            if(NULL!=filename && g_str_has_suffix(filename, ".desktop"))
-            {
-                g_free(_fs.data);
-                g_free(filename);
+            if(_is_desktop_file(f))
                 return FILES_COMPRESSIBLE_NONE;
-            }
         }
 
         if(all_compressed)
-        {
-            g_free(_fs.data);
             return FILES_COMPRESSIBLE_ALL;
-        }
     }
 
-    if(_fs.data != NULL)
-    {
-        g_free(_fs.data);
-    }
     return FILES_COMPRESSIBLE;
 }
 
-static gboolean
-_file_is_archive (GFile *file)
-{
-    char *mime_type = NULL;
-    guint i;
-    static const char * archive_mime_types[] = { "application/x-gtar",
-        "application/x-zip",
-        "application/x-zip-compressed",
-        "application/zip",
-        "application/x-zip",
-        "application/x-tar",
-        "application/x-7z-compressed",
-        "application/x-rar",
-        "application/x-rar-compressed",
-        "application/x-jar",
-        "application/x-java-archive",
-        "application/x-war",
-        "application/x-ear",
-        "application/x-arj",
-        "application/x-gzip",
-        "application/gzip",
-        "application/x-bzip-compressed-tar",
-        "application/x-compressed-tar",
-        "application/x-archive",
-        "application/x-xz-compressed-tar",
-        "application/x-bzip",
-        "application/x-cbz",
-        "application/x-xz",
-        "application/x-lzma-compressed-tar",
-        "application/x-ms-dos-executable",
-        "application/x-lzma",
-        "application/x-cd-image",
-        "application/x-deb",
-        "application/x-rpm",
-        "application/x-stuffit",
-        "application/x-tzo",
-        "application/x-tarz",
-        "application/x-tzo",
-        "application/x-msdownload",
-        "application/x-lha",
-        "application/x-zoo"};
-
-    g_return_val_if_fail (file != NULL, FALSE);
-
-    GFileInfo* info = g_file_query_info(file, "standard::content-type", G_FILE_QUERY_INFO_NONE, NULL, NULL);
-    if (info != NULL) {
-        mime_type = (char*)g_file_info_get_attribute_string(info, G_FILE_ATTRIBUTE_STANDARD_CONTENT_TYPE);
-        char* path = g_file_get_path(file);
-        g_debug("[%s] \"%s\" MINE type is: \"%s\"", __func__, path, mime_type);
-        g_free(path);
+static void
+_free_normalized_container (ArrayContainer fs)
+{
+    for (size_t i=0; i<fs.num; i++) {
+        if (((GObject**)fs.data)[i] != NULL)
+            g_object_unref(((GObject**)fs.data)[i]);
+    }
+    g_free(fs.data);
+}
 
-        for (i = 0; i < G_N_ELEMENTS (archive_mime_types); i++) {
-            if (!strcmp (mime_type, archive_mime_types[i])) {
-                return TRUE;
-            }
+JS_EXPORT_API
+double dentry_files_compressibility(ArrayContainer fs)
+{
+    ArrayContainer _fs = _normalize_array_container(fs);
+    GFile** files = _fs.data;
+
+    const char** content_types = g_new0(const char*, _fs.num);
+    for (size_t i=0; i<_fs.num; i++) {
+        if (files[i] != NULL)
+            content_types[i] = gfile_get_content_type(files[i], G_FILE_QUERY_INFO_NONE);
+    }
+
+    int compressibility = _files_compressibility(files, content_types, _fs.num);
+    g_free(content_types);
+    _free_normalized_container(_fs);
+
+    return compressibility;
+}
+
+/*
+ * Everything the context menu of a selection needs in one call, each file is
+ * queried once. The bits are listed in dentry.cfg for the JS side:
+ *
+ *   bits 0-1  the files_compressibility value
+ *   SELECTION_CAN_PASTE           the clipboard has files
+ *   SELECTION_SHOULD_MOVE         every file should_move
+ *   SELECTION_FILEROLLER_EXIST    is_fileroller_exist
+ *   SELECTION_HAS_NON_DIRECTORY   get_templates_filter isn't empty
+ */
+#define SELECTION_COMPRESSIBILITY_MASK 0x3
+#define SELECTION_CAN_PASTE            (1 << 2)
+#define SELECTION_SHOULD_MOVE          (1 << 3)
+#define SELECTION_FILEROLLER_EXIST     (1 << 4)
+#define SELECTION_HAS_NON_DIRECTORY    (1 << 5)
+
+JS_EXPORT_API
+double dentry_get_selection_capabilities(ArrayContainer fs)
+{
+    ArrayContainer _fs = _normalize_array_container(fs);
+    GFile** files = _fs.data;
+
+    const char** content_types = g_new0(const char*, _fs.num);
+    gboolean should_move = _fs.num != 0;
+    gboolean has_non_directory = FALSE;
+
+    for (size_t i=0; i<_fs.num; i++) {
+        if (files[i] == NULL) {
+            should_move = FALSE;
+            continue;
+        }
+
+        GFileInfo* info = g_file_query_info(files[i],
+                                            G_FILE_ATTRIBUTE_STANDARD_TYPE ","
+                                            G_FILE_ATTRIBUTE_STANDARD_CONTENT_TYPE ","
+                                            G_FILE_ATTRIBUTE_ACCESS_CAN_DELETE,
+                                            G_FILE_QUERY_INFO_NONE,
+                                            NULL, NULL);
+        if (info == NULL) {
+            should_move = FALSE;
+            has_non_directory = TRUE;
+            continue;
         }
+
+        const char* content_type = g_file_info_get_content_type(info);
+        if (content_type != NULL)
+            content_types[i] = g_intern_string(content_type);
+        if (g_file_info_get_file_type(info) != G_FILE_TYPE_DIRECTORY)
+            has_non_directory = TRUE;
+        if (!g_file_is_native(files[i])
+            || !g_file_info_get_attribute_boolean(info, G_FILE_ATTRIBUTE_ACCESS_CAN_DELETE))
+            should_move = FALSE;
         g_object_unref(info);
     }
-    return FALSE;
+
+    int caps = _files_compressibility(files, content_types, _fs.num) & SELECTION_COMPRESSIBILITY_MASK;
+    g_free(content_types);
+    _free_normalized_container(_fs);
+
+    if (!is_clipboard_empty())
+        caps |= SELECTION_CAN_PASTE;
+    if (should_move)
+        caps |= SELECTION_SHOULD_MOVE;
+    if (dentry_is_fileroller_exist())
+        caps |= SELECTION_FILEROLLER_EXIST;
+    if (has_non_directory)
+        caps |= SELECTION_HAS_NON_DIRECTORY;
+
+    return caps;
 }
 
 JS_EXPORT_API
@@ -1201,22 +1236,13 @@ ArrayContainer dentry_get_templates_filter(ArrayContainer fs)
 JS_EXPORT_API
 GFile* dentry_create_templates(GFile* src, char* name_add_before)
 {
-    gboolean result G_GNUC_UNUSED = FALSE;
+    gboolean result = FALSE;
     const char* basename = dentry_get_name(src);
     g_debug("choose templates name :---%s---",basename);
 
     GFile* dir = g_file_new_for_path(DESKTOP_DIR());
-
-
-    char* name = g_strdup(basename);
-    GFile* child = g_file_get_child(dir, name);
-    for (int i=0; g_file_query_exists(child, NULL) && (i<500); i++) {
-        g_object_unref(child);
-        g_free(name);
-        name = g_strdup_printf("%s(%d)%s",name_add_before, i,basename);
-        child = g_file_get_child(dir, name);
-    }
-
+    GFile* child = desktop_names_get_free_child(dir, basename, name_add_before, basename);
+    char* name = g_file_get_basename(child);
     g_debug("choose templates new name :---%s---",name);
 
     //we should check @src type  to use diff method.
@@ -1225,11 +1251,12 @@ GFile* dentry_create_templates(GFile* src, char* name_add_before)
     {
         result = g_file_make_directory (child, NULL, NULL);
         g_debug ("create_templates: new directory : g_file_make_directory : %s", name);
-        ArrayContainer ac;
-        ac = dentry_list_files(src);
-        dentry_copy(ac,child);
-        ArrayContainer_free(ac);
-        result = TRUE;
+        if (result) {
+            ArrayContainer ac;
+            ac = dentry_list_files(src);
+            dentry_copy(ac,child);
+            ArrayContainer_free(ac);
+        }
     }
     else
     {
@@ -1238,6 +1265,9 @@ GFile* dentry_create_templates(GFile* src, char* name_add_before)
         g_debug ("create_templates: new file : %s", uri);
         g_free((char*)uri);
     }
+    if (!result)
+        desktop_names_unreserve(child);
+    g_free(name);
     g_object_unref(dir);
 
     return child;
@@ -1247,80 +1277,14 @@ GFile* dentry_create_templates(GFile* src, char* name_add_before)
 PRIVATE
 gboolean _is_valid_category(char const* category)
 {
-#define CATEGORY_FILTER DATA_DIR"/category_filter.ini"
-    GKeyFile* filter_file = g_key_file_new();
-    GError* err = NULL;
-    if (!g_key_file_load_from_file(filter_file, CATEGORY_FILTER, G_KEY_FILE_NONE, &err)) {
-        g_warning("[Error] read file %s failed: %s", CATEGORY_FILTER, err->message);
-        g_error_free(err);
-        return TRUE;
-    }
-
-    gboolean is_valid = TRUE;
-    gsize size = 0;
-    char** filter = g_key_file_get_string_list(filter_file, "Main", "filter", &size, NULL);
-
-    for (guint i = 0; i < size; ++i) {
-        char* uppercase_filter = g_strdup(filter[i]);
-        char* uppercase_category = g_strdup(category);
-
-        g_debug("compare #%s# with #%s#: %d", uppercase_category, uppercase_filter, 0 == g_strcmp0(uppercase_category, uppercase_filter));
-
-        if (0 == g_strcmp0(uppercase_category, uppercase_filter)) {
-            is_valid = FALSE;
-            g_free(uppercase_category);
-            g_free(uppercase_filter);
-            break;
-        }
-
-        g_free(uppercase_category);
-        g_free(uppercase_filter);
-    }
-
-    g_strfreev(filter);
-    g_key_file_unref(filter_file);
-#undef CATEGORY_FILTER
-
-    return is_valid;
+    return !is_filtered_category(category);
 }
 
 
 PRIVATE
 gboolean _is_generic_category(char const* category)
 {
-#define CATEGORY_FILTER DATA_DIR"/category_filter.ini"
-    GKeyFile* filter_file = g_key_file_new();
-    GError* err = NULL;
-    if (!g_key_file_load_from_file(filter_file, CATEGORY_FILTER, G_KEY_FILE_NONE, &err)) {
-        g_warning("[Error] read file %s failed: %s", CATEGORY_FILTER, err->message);
-        g_error_free(err);
-        return TRUE;
-    }
-
-    gboolean is_generic = FALSE;
-    gsize size = 0;
-    char** filter = g_key_file_get_string_list(filter_file, "Aux", "filter", &size, NULL);
-    for (int i = 0; filter[i] != NULL; ++i) {
-        char* uppercase_category = g_strdup(category);
-        char* uppercase_filter = g_strdup(filter[i]);
-
-        g_debug("compare #%s# with #%s#: %d", uppercase_filter, uppercase_category, 0 == g_strcmp0(uppercase_category, uppercase_filter));
-        if (0 == g_strcmp0(uppercase_category, uppercase_filter)) {
-            is_generic = TRUE;
-            g_free(uppercase_category);
-            g_free(uppercase_filter);
-            break;
-        }
-
-        g_free(uppercase_category);
-        g_free(uppercase_filter);
-    }
-
-    g_strfreev(filter);
-    g_key_file_unref(filter_file);
-#undef CATEGORY_FILTER
-
-    return is_generic;
+    return is_generic_category(category);
 }
 
 
@@ -1339,16 +1303,14 @@ char** _get_desktop_file_category(GDesktopAppInfo* f)
 }
 
 
+/* the keys of the returned table are interned strings, don't free them. */
 PRIVATE
 GHashTable* _count_categories(ArrayContainer const fs)
 {
-    GHashTable* categories_count = g_hash_table_new_full(g_str_hash,
-                                                         g_str_equal,
-                                                         g_free, NULL);
+    GHashTable* categories_count = g_hash_table_new(g_direct_hash, g_direct_equal);
+    GHashTable* set = g_hash_table_new(g_direct_hash, g_direct_equal);
 
     for (guint i = 0; i < fs.num; ++i) {
-        GHashTable* set = g_hash_table_new_full(g_str_hash, g_str_equal,
-                                                g_free, NULL);
         char** categories =
             _get_desktop_file_category(((GDesktopAppInfo**)fs.data)[i]);
 
@@ -1361,35 +1323,28 @@ GHashTable* _count_categories(ArrayContainer const fs)
             return NULL;
         }
 
+        g_hash_table_remove_all(set);
         for (int j = 0; categories[j] != NULL && categories[j][0] != '\0'; ++j) {
-            char* uppercase_category = g_strdup(categories[j]);
+            const char* category = g_intern_string(categories[j]);
 
-            if (g_hash_table_contains(set, uppercase_category)) {
-                g_free(uppercase_category);
+            if (g_hash_table_contains(set, category))
                 continue;
-            }
 
-            // Do not free uppercase_category explicitly, use g_hash_table_unref
-            // to free uppercase_category, so that do not duplicate it here.
-            g_hash_table_add(set, uppercase_category);
-
-            if (_is_valid_category(uppercase_category)) {
-                g_debug("[%s] === insert category: %s (uppercase: %s) uppercase_category and categories:%s", __func__,
-                        categories[j], uppercase_category,categories[j]);
+            g_hash_table_add(set, (gpointer)category);
 
+            if (_is_valid_category(category)) {
                 int value =
                     GPOINTER_TO_INT(g_hash_table_lookup(categories_count,
-                                                        uppercase_category));
-                g_hash_table_insert(categories_count,
-                                    g_strdup(uppercase_category),
+                                                        category));
+                g_hash_table_insert(categories_count, (gpointer)category,
                                     GINT_TO_POINTER(value + 1));
             }
         }
 
         g_strfreev(categories);
-        g_hash_table_unref(set);
     }
 
+    g_hash_table_unref(set);
     return categories_count;
 }
 
@@ -1403,9 +1358,9 @@ void _get_cadidate_categories(gpointer key, gpointer value, gpointer user_data)
     if ((guint)GPOINTER_TO_INT(value) == fs->num) {
         if (candidate_categories->len > 1) {
             if (!_is_generic_category(key))
-                g_ptr_array_add(candidate_categories, g_strdup(key));
+                g_ptr_array_add(candidate_categories, key);
         } else {
-            g_ptr_array_add(candidate_categories, g_strdup(key));
+            g_ptr_array_add(candidate_categories, key);
         }
     }
 }
@@ -1414,36 +1369,32 @@ void _get_cadidate_categories(gpointer key, gpointer value, gpointer user_data)
 PRIVATE
 char* _get_group_name_from_category_field(ArrayContainer const fs)
 {
-    char* group_name = g_strdup(_("App Group"));
-
     GHashTable* categories_count = _count_categories(fs);
 
     if (categories_count == NULL)
-        return group_name;
+        return g_strdup(_("App Group"));
 
-    GPtrArray* candidate_categories = g_ptr_array_new_with_free_func(g_free);
-    candidate_categories->len = 0;
+    GPtrArray* candidate_categories = g_ptr_array_new();
 
     void* user_data[] = { (ArrayContainer*)(&fs), candidate_categories };
     g_hash_table_foreach(categories_count, _get_cadidate_categories, user_data);
 
-    if (candidate_categories->len == 0)
+    char* group_name = NULL;
+    if (candidate_categories->len == 0) {
+        group_name = g_strdup(_("App Group"));
         goto out;
+    }
 
-    char* candidate = NULL;
+    const char* candidate = NULL;
     for (guint i = 0; candidate_categories->len > 1
          && i < candidate_categories->len; ++i) {
-        if (!_is_generic_category(g_ptr_array_index(candidate_categories, i))) {
-            g_free(candidate);
-            candidate = g_strdup(g_ptr_array_index(candidate_categories, i));
-        }
+        if (!_is_generic_category(g_ptr_array_index(candidate_categories, i)))
+            candidate = g_ptr_array_index(candidate_categories, i);
     }
 
-    g_free(group_name);
     if (candidate == NULL)  // all candidate categories is generic category
-        group_name = g_strdup(g_ptr_array_index(candidate_categories, 0));
-    else
-        group_name = candidate;
+        candidate = g_ptr_array_index(candidate_categories, 0);
+    group_name = g_strdup(candidate);
 
 out:
     g_ptr_array_unref(candidate_categories);
@@ -1455,48 +1406,13 @@ out:
 
 
 PRIVATE
-int _get_category_name(void* _basename, int argc G_GNUC_UNUSED, char** argv, char** columnname G_GNUC_UNUSED)
-{
-    char** basename = (char**)_basename;
-    if (argv[0][0] != '\0')
-        *basename = g_strdup(argv[0]);
-    return 0;
-}
-
-
-PRIVATE
-char* _lookup(char const* basename)
+const char* _get_category(GHashTable* category_map, GDesktopAppInfo* app)
 {
-    char* category_name = NULL;
-    char* desktop_name = g_strdup_printf("%s.desktop",basename);
-
-    GString* sql = g_string_new("select first_category_name from desktop where desktop_name = \"");
-    g_string_append(sql, desktop_name);
-    g_string_append(sql, "\";");
-
-    search_database(get_category_name_db_path(), sql->str, _get_category_name,
-                    &category_name);
-
-    g_string_free(sql, TRUE);
-    g_debug("[%s]:==%s==;return==%s==",__func__,desktop_name,category_name);
+    char* desktop_name = g_path_get_basename(g_desktop_app_info_get_filename(app));
+    const char* category = g_hash_table_lookup(category_map, desktop_name);
+    g_debug("[%s]:==%s==;return==%s==",__func__,desktop_name,category);
     g_free(desktop_name);
-    return category_name;
-}
-
-
-PRIVATE
-char* _get_category(GDesktopAppInfo* app)
-{
-    char* basename = get_basename_without_extend_name(g_desktop_app_info_get_filename(app));
-    char* category = _lookup(basename);
-    g_free(basename);
 
-    if (category == NULL || category[0] == '\0'){
-        g_debug("[%s] return NULL",__func__);
-        return NULL;
-    }
-
-    g_debug("[%s] return:%s",__func__,category);
     return category;
 }
 
@@ -1506,31 +1422,23 @@ char* _get_group_name_from_software_center(ArrayContainer const fs)
 {
     g_assert(fs.num > 1);
 
+    GHashTable* category_map = get_category_map();
     GDesktopAppInfo** datas = (GDesktopAppInfo**)fs.data;
-    char* category = _get_category(datas[0]);
-    char* another_category = NULL;
+    const char* category = _get_category(category_map, datas[0]);
 
     if (category == NULL)
         goto errorout;
 
+    // the category names are interned, compare the pointers directly.
     for (guint i = 1; i < fs.num; ++i) {
-        g_free(another_category);
-        another_category = _get_category(datas[i]);
-
-        if (another_category == NULL)
-            goto errorout;
-
-        if (0 != g_strcmp0(category, another_category))
+        if (category != _get_category(category_map, datas[i]))
             goto errorout;
     }
 
-    g_free(another_category);
     g_debug("[%s]:%s",__func__,category);
-    return category;
+    return g_strdup(category);
 
 errorout:
-    g_free(category);
-    g_free(another_category);
     g_debug("[%s] return NULL",__func__);
     return NULL;
 }
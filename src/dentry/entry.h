@@ -1,4 +1,5 @@
 #ifndef __DENTRY_H__
+#define __DENTRY_H__
 
 #include <glib.h>
 #include <gio/gio.h>
@@ -0,0 +1,213 @@
+/**
+ * Copyright (c) 2011 ~ 2014 Deepin, Inc.
+ *               2011 ~ 2014 snyh
+ *
+ * Author:      snyh <snyh@snyh.org>
+ * Maintainer:  snyh <snyh@snyh.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ **/
+#define _GNU_SOURCE
+#include <string.h>
+#include <sys/stat.h>
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <gio/gio.h>
+#include <gio/gdesktopappinfo.h>
+
+#include "entry_cache.h"
+
+/*
+ * An edit within the same second may keep st_mtime, compare the nanoseconds,
+ * the ctime and the size as well.
+ */
+typedef struct _FileStamp {
+    struct timespec mtime;
+    struct timespec ctime;
+    off_t size;
+} FileStamp;
+
+typedef struct _CachedEntry {
+    Entry* entry;
+    FileStamp stamp;
+} CachedEntry;
+
+/*
+ * path (or uri for non-native files) -> CachedEntry. The path comes from
+ * g_file_get_path, which drops "." and ".." components and duplicate or
+ * trailing slashes; symlinks are not resolved, a link on the desktop is an
+ * entry of its own.
+ */
+static GHashTable* _entries = NULL;
+/* the Entry* handed to JS, each holds one reference until dentry_release */
+static GHashTable* _js_handles = NULL;
+
+
+static void _cached_entry_free(CachedEntry* cached)
+{
+    g_object_unref(cached->entry);
+    g_slice_free(CachedEntry, cached);
+}
+
+
+static GHashTable* _get_entries()
+{
+    if (_entries == NULL)
+        _entries = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+                                         (GDestroyNotify)_cached_entry_free);
+    return _entries;
+}
+
+
+static char* _get_key(GFile* f)
+{
+    char* key = g_file_get_path(f);
+    if (key == NULL)
+        key = g_file_get_uri(f);
+    return key;
+}
+
+
+static void _get_stamp(char const* path, FileStamp* stamp)
+{
+    GStatBuf st;
+    memset(stamp, 0, sizeof(FileStamp));
+    if (path[0] != '/' || g_stat(path, &st) != 0)
+        return;
+    stamp->mtime = st.st_mtim;
+    stamp->ctime = st.st_ctim;
+    stamp->size = st.st_size;
+}
+
+
+static gboolean _stamp_equal(FileStamp const* a, FileStamp const* b)
+{
+    return a->mtime.tv_sec == b->mtime.tv_sec && a->mtime.tv_nsec == b->mtime.tv_nsec
+        && a->ctime.tv_sec == b->ctime.tv_sec && a->ctime.tv_nsec == b->ctime.tv_nsec
+        && a->size == b->size;
+}
+
+
+/*
+ * Get the Entry of @path, a GDesktopAppInfo for .desktop files and a GFile
+ * for others. The same object is returned for the same path until
+ * the file's mtime, ctime or size changes or it is removed by
+ * entry_cache_remove.
+ *
+ * Return a new reference.
+ */
+Entry* entry_cache_lookup(const char* path)
+{
+    GFile* f = g_file_new_for_commandline_arg(path);
+    char* key = _get_key(f);
+    FileStamp stamp;
+    _get_stamp(key, &stamp);
+
+    CachedEntry* cached = g_hash_table_lookup(_get_entries(), key);
+    if (cached != NULL && _stamp_equal(&cached->stamp, &stamp)) {
+        g_free(key);
+        g_object_unref(f);
+        return g_object_ref(cached->entry);
+    }
+
+    Entry* e = NULL;
+    if (g_str_has_suffix(key, ".desktop"))
+        e = g_desktop_app_info_new_from_filename(key);
+
+    if (e == NULL)
+        e = g_object_ref(f);
+    g_object_unref(f);
+
+    cached = g_slice_new(CachedEntry);
+    cached->entry = e;
+    cached->stamp = stamp;
+    g_hash_table_replace(_entries, key, cached);
+
+    return g_object_ref(e);
+}
+
+
+void entry_cache_remove(const char* path)
+{
+    if (_entries == NULL)
+        return;
+
+    GFile* f = g_file_new_for_commandline_arg(path);
+    char* key = _get_key(f);
+    g_object_unref(f);
+
+    g_hash_table_remove(_entries, key);
+    g_free(key);
+}
+
+
+/*
+ * Take the cached Entry of @f out of the cache, the reference held by the
+ * cache is transferred to the caller. Return a new reference of @f if it is
+ * not cached.
+ */
+Entry* entry_cache_take(GFile* f)
+{
+    char* key = _get_key(f);
+    CachedEntry* cached = _entries ? g_hash_table_lookup(_entries, key) : NULL;
+
+    Entry* e = NULL;
+    if (cached != NULL) {
+        e = g_object_ref(cached->entry);
+        g_hash_table_remove(_entries, key);
+    } else {
+        e = g_object_ref(f);
+    }
+
+    g_free(key);
+    return e;
+}
+
+
+void entry_cache_clear()
+{
+    if (_entries != NULL)
+        g_hash_table_remove_all(_entries);
+}
+
+
+/*
+ * Mark @e as being held by the JS side. The native object pointer is used as
+ * the JS handle, so it is kept alive until JS releases it by dentry_release,
+ * even after it left the cache. Exporting the same object several times only
+ * holds one reference.
+ */
+Entry* entry_cache_export(Entry* e)
+{
+    if (e == NULL)
+        return NULL;
+
+    if (_js_handles == NULL)
+        _js_handles = g_hash_table_new_full(g_direct_hash, g_direct_equal,
+                                            g_object_unref, NULL);
+
+    if (!g_hash_table_contains(_js_handles, e))
+        g_hash_table_add(_js_handles, g_object_ref(e));
+
+    return e;
+}
+
+
+JS_EXPORT_API
+void dentry_release(Entry* e)
+{
+    if (_js_handles != NULL)
+        g_hash_table_remove(_js_handles, e);
+}
@@ -0,0 +1,15 @@
+#ifndef _ENTRY_CACHE_H_
+#define _ENTRY_CACHE_H_
+
+#include <gio/gio.h>
+#include "entry.h"
+
+Entry* entry_cache_lookup(const char* path); // new reference
+Entry* entry_cache_take(GFile* f); // new reference
+void entry_cache_remove(const char* path);
+void entry_cache_clear();
+
+Entry* entry_cache_export(Entry* e);
+void dentry_release(Entry* e);
+
+#endif
@@ -9,6 +9,7 @@
 #include "common/utils.h"
 #include "fileops.h"
 #include "fileops_error_reporting.h"
+#include "desktop_names.h"
 
 #define DBUS_NAUTILUS_NAME  "org.gnome.Nautilus"
 #define DBUS_NAUTILUS_PATH  "/org/gnome/Nautilus"
@@ -398,31 +399,26 @@ fileops_copy (GFile* file_list[], guint num, GFile* dest_dir)
         // here ,we should first check the src directory is the same as the dest directory
         // if is same , we should change the copy_dest_file by changing src_basename
          char* src_basename = g_file_get_basename (src);
-         char* name = g_strdup(src_basename);
-         GFile* child = g_file_get_child(dest_dir, name);
+         GFile* child = NULL;
          const char* name_add_before = _("Untitled");
 
          GFile* parent = g_file_get_parent(src);
          char* parent_uri = g_file_get_uri(parent);
          g_object_unref(parent);
          if(0 == g_strcmp0(parent_uri,dest_dir_uri))
-         {
-             for (int i=0; g_file_query_exists(child, NULL) && (i<500); i++) {
-                g_object_unref(child);
-                g_free(name);
-                name = g_strdup_printf("%s(%d)%s",name_add_before, i,src_basename);
-                child = g_file_get_child(dest_dir, name);
-             }
-         }
+             child = desktop_names_get_free_child(dest_dir, src_basename, name_add_before, src_basename);
+         else
+             child = g_file_get_child(dest_dir, src_basename);
 
         g_free (dest_dir_uri);
         g_free (src_basename);
-        g_free(name);
         g_free(parent_uri);
 
         data->dest_file = child;
         traverse_directory (src, _copy_files_async, _dummy_func, data);
 
+        // the copy failed or was cancelled before creating anything.
+        desktop_names_unreserve (data->dest_file);
         g_object_unref (data->dest_file);
     }
     g_object_unref (data->cancellable);
@@ -19,18 +19,21 @@ static FileOpsClipboardInfo	clipboard_info = {
                                 .file_list = NULL,
 				.num       = 0,
 				.cut       = FALSE,
+				.file_set  = NULL,
 				};
 //used to track latest cut files.
 static FileOpsClipboardInfo	clipboard_info_prev = {
 				.file_list = NULL,
 				.num	   = 0,
 				.cut	   = FALSE, // this boolean is a useful indicator
+				.file_set  = NULL,
 				};
 // used to store data requested from another owner.
 static FileOpsClipboardInfo	clipboard_info_tmp = {
                                 .file_list = NULL,
 				.num       = 0,
 				.cut       = FALSE,
+				.file_set  = NULL,
 				};
 
 static GdkAtom			copied_files_atom = GDK_NONE;
@@ -54,7 +57,11 @@ static void __clear_clipboard_info	(FileOpsClipboardInfo* info);
 //@info: input, @dest: output
 static void __copy_clipboard_info	(FileOpsClipboardInfo* info, FileOpsClipboardInfo* dest);
 //
-static GList* __set_diff_clipboard_info (FileOpsClipboardInfo* A, FileOpsClipboardInfo* B);
+static GPtrArray* __set_diff_clipboard_info (FileOpsClipboardInfo* A, FileOpsClipboardInfo* B);
+//lazily build the hashed set of @info's file_list.
+static GHashTable* __get_clipboard_file_set (FileOpsClipboardInfo* info);
+//post all files in @files as one "cut_completed" message.
+static void __post_cut_completed (GFile** files, guint num);
 //check if we're current the owner of the clipboard.
 //static gboolean __is_owner_of_clipboard	();
 //return true if valid clipboard, otherwise, FALSE
@@ -110,13 +117,7 @@ fileops_paste (GFile* dest_dir)
     {
 	fileops_move (real_info->file_list, real_info->num, dest_dir, TRUE);
         //post messages event paste cancelled or failed.
-	json_object* json = json_object_new_array();
-	for (guint i = 0; i < real_info->num; i++)
-	{
-      json_object_array_put_idx(json, i, json_object_new_int64((int64_t)real_info->file_list[i]));
-            g_debug ("send file: %d : %s", i, g_file_get_uri (real_info->file_list[i]));
-	}
-	js_post_message ("cut_completed", json);
+	__post_cut_completed (real_info->file_list, real_info->num);
 
         gtk_clipboard_clear (gtk_clipboard_get (GDK_SELECTION_CLIPBOARD));
 
@@ -157,11 +158,7 @@ init_fileops_clipboard (GFile* file_list[], guint num, gboolean cut)
     //set prev clipboard_info
     __clear_clipboard_info (&clipboard_info_prev);
     __copy_clipboard_info (&clipboard_info, &clipboard_info_prev);
-
-    for (guint j = 0; j < clipboard_info_prev.num; j++)
-    {
-	g_debug ("init_fileops prev: file_list[%d] = %s", j, g_file_get_uri (clipboard_info_prev.file_list[j]));
-    }
+    g_debug ("init_fileops prev: num = %d", clipboard_info_prev.num);
     //we're the clipboard owner, cleanup clipboard_info
     __clear_clipboard_info (&clipboard_info);
 
@@ -169,8 +166,8 @@ init_fileops_clipboard (GFile* file_list[], guint num, gboolean cut)
     for (guint i = 0; i < num; i++)
     {
 	clipboard_info.file_list[i] = g_object_ref (file_list[i]);
-	g_debug ("init_fileops %s: file_list[%d] = %s", cut? "cut": "paste", i, g_file_get_uri (file_list[i]));
     }
+    g_debug ("init_fileops %s: num = %d", cut? "cut": "paste", num);
     clipboard_info.num = num;
     clipboard_info.cut = cut;
 
@@ -294,40 +291,43 @@ _clear_clipboard_callback (GtkClipboard *clipboard G_GNUC_UNUSED,
 {
     g_debug ("_clear_clipboard_callback: begin");
 
-    GList* file_list = NULL;
-
     g_debug ("prev: num = %d; operation = %s", clipboard_info_prev.num, clipboard_info_prev.cut?"cut":"copy");
     if (clipboard_info_prev.cut == FALSE)
     {
 	if (clipboard_info.cut == TRUE)
-	{
-	    for (guint i = 0; i < clipboard_info.num; i++)
-	    {
-		file_list = g_list_append (file_list, g_object_ref (clipboard_info.file_list[i]));
-	    }
-	}
+	    __post_cut_completed (clipboard_info.file_list, clipboard_info.num);
+	else
+	    __post_cut_completed (NULL, 0);
     }
     //clipboard_info_prev.cut == TRUE)
     else if (clipboard_info_prev.num != 0)
     {
-	file_list = __set_diff_clipboard_info (&clipboard_info, &clipboard_info_prev);
+	GPtrArray* files = __set_diff_clipboard_info (&clipboard_info, &clipboard_info_prev);
+	__post_cut_completed ((GFile**)files->pdata, files->len);
+	g_ptr_array_free (files, TRUE);
     }
-    // send message.
-    int i = 0;
-    GList* l = NULL;
-    json_object* json = json_object_new_array();
-    for (l = file_list; l != NULL; l = l->next)
+    else
     {
-  json_object_array_put_idx(json, i, json_object_new_int64((int64_t)l->data));
-        g_debug ("send file: %d : %s", i, g_file_get_uri (l->data));
-	i++;
+	__post_cut_completed (NULL, 0);
     }
-    js_post_message ("cut_completed", json);
-    //
-    g_list_free_full (file_list, g_object_unref);
     __clear_clipboard_info (&clipboard_info_prev);
     g_debug ("_clear_clipboard_callback: end");
 }
+/*
+ *	the files are sent in one message as plain handles, they are only
+ *	compared with the handles JS already holds.
+ */
+static void
+__post_cut_completed (GFile** files, guint num)
+{
+    json_object* json = json_object_new_array();
+    for (guint i = 0; i < num; i++)
+    {
+	json_object_array_add (json, json_object_new_int64 ((int64_t)files[i]));
+    }
+    g_debug ("send %d files", num);
+    js_post_message ("cut_completed", json);
+}
 /*
  *	this is clipboard nautilus convention
  * 	@format_for_text : TRUE: (<path_name> '\n')* <path_name>
@@ -482,52 +482,46 @@ __clipboard_contents_received_callback (GtkClipboard     *clipboard G_GNUC_UNUSE
  *	@B : the previous clipboard_info
  *	@return B-A: the set of files we need to un-fade on the desktop.
  */
-static GList*
+static GPtrArray*
 __set_diff_clipboard_info (FileOpsClipboardInfo* A, FileOpsClipboardInfo* B)
 {
     //previous clipboard_info operation must be 'cut'.
     g_assert (B->cut == TRUE);
 
-    GList* file_list = NULL;
+    GPtrArray* file_list = g_ptr_array_sized_new (B->num);
 
-#if 0
-    g_debug ("__set_diff: A op : %s", A->cut?"cut":"paste");
-    for (int i=0; i<A->num; i++)
-    {
-	g_debug ("A: %d : %s", i, g_file_get_uri (A->file_list[i]));
-    }
-#endif
     //send all files in B
     if (A->cut != B->cut)
     {
 	for (guint i = 0; i < B->num; i++)
-	{
-	    GFile* dup_file = g_file_dup (B->file_list[i]);
-	    file_list = g_list_append (file_list, dup_file);
-	}
+	    g_ptr_array_add (file_list, B->file_list[i]);
     }
     else
     {
+	GHashTable* A_set = __get_clipboard_file_set (A);
 	for (guint i = 0; i < B->num; i++)
 	{
-	    gboolean is_in_A = FALSE;
-	    for (guint j = 0; j < A->num; j++)
-	    {
-	    	if (g_file_equal (B->file_list[i], A->file_list[j]))
-	    	{
-		    is_in_A = TRUE;
-		    break;
-		}
-	    }
-	    if (!is_in_A)
-	    {
-		GFile* dup_file = g_file_dup (B->file_list[i]);
-            	file_list = g_list_append (file_list, dup_file);
-	    }
+	    if (!g_hash_table_contains (A_set, B->file_list[i]))
+		g_ptr_array_add (file_list, B->file_list[i]);
 	}
     }
     return file_list;
 }
+/*
+ *	the set is built on first use and dropped with the file_list,
+ *	it doesn't hold extra references of the files.
+ */
+static GHashTable*
+__get_clipboard_file_set (FileOpsClipboardInfo* info)
+{
+    if (info->file_set == NULL)
+    {
+	info->file_set = g_hash_table_new (g_file_hash, (GEqualFunc)g_file_equal);
+	for (guint i = 0; i < info->num; i++)
+	    g_hash_table_add (info->file_set, info->file_list[i]);
+    }
+    return info->file_set;
+}
 /*
  *	NOTE: we assume that both @info and @dest
  *	      are  pointers to static storage. so
@@ -563,6 +557,12 @@ __copy_clipboard_info (FileOpsClipboardInfo* info, FileOpsClipboardInfo* dest)
 static void
 __clear_clipboard_info	(FileOpsClipboardInfo* info)
 {
+    if (info->file_set != NULL)
+    {
+	g_hash_table_destroy (info->file_set);
+	info->file_set = NULL;
+    }
+
     if (info->file_list == NULL)
     {
 	return;
@@ -571,7 +571,6 @@ __clear_clipboard_info	(FileOpsClipboardInfo* info)
     g_debug ("free: operation: %s, num: %d", info->cut? "cut": "copy", info->num);
     for (guint i = 0; i < info->num; i++)
     {
-	g_debug ("free: file_list[%d] = %s", i, g_file_get_uri (info->file_list[i]));
 	g_object_unref (info->file_list[i]);
     }
     g_free (info->file_list);
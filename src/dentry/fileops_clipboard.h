@@ -11,6 +11,7 @@ struct _FileOpsClipboardInfo
 	GFile**   file_list;	    // list of GFiles
 	guint	  num;
 	gboolean  cut;       //TRUE, cut; FALSE, copy
+	GHashTable* file_set; // hashed file_list, built on demand
 };
 
 void fileops_paste	    (GFile* dest_dir);
@@ -7,6 +7,7 @@
 
 #include "common/xdg_misc.h"
 #include "fileops_trash.h"
+#include "trash_watcher.h"
 
 static GList *  _get_trash_dirs_for_mount       (GMount *mount);
 static void     _delete_trash_file              (GFile *file,
@@ -25,15 +26,7 @@ GFile* fileops_get_trash_entry()
 }
 double fileops_get_trash_count()
 {
-    GFile* _trash_can = fileops_get_trash_entry ();
-    GFileInfo* info = g_file_query_info(_trash_can, G_FILE_ATTRIBUTE_TRASH_ITEM_COUNT, G_FILE_QUERY_INFO_NONE, NULL, NULL);
-    double count = 0;
-    if (info != NULL) { // info maybe equal NULL when use xinit run desktop
-        count = g_file_info_get_attribute_uint32(info, G_FILE_ATTRIBUTE_TRASH_ITEM_COUNT);
-        g_object_unref(info);
-    }
-    g_object_unref(_trash_can);
-    return count;
+    return trash_watcher_get_count();
 }
 
 static gboolean
@@ -0,0 +1,373 @@
+/**
+ * Copyright (c) 2011 ~ 2012 Deepin, Inc.
+ *               2011 ~ 2012 snyh
+ *
+ * Author:      snyh <snyh@snyh.org>
+ * Maintainer:  snyh <snyh@snyh.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ **/
+#define _GNU_SOURCE
+#include <sys/types.h>
+#include <errno.h>
+#include <signal.h>
+#include <spawn.h>
+#include <unistd.h>
+
+#include <gtk/gtk.h>
+#include <gdk/gdkx.h>
+#include <gio/gdesktopappinfo.h>
+
+#include "common/X_misc.h"
+#include "dcore/signal.h"
+#include "dcore/perf_stats.h"
+#include "launch_service.h"
+
+
+// give up waiting for the first window after this.
+#define LAUNCH_MAP_TIMEOUT_SEC 15
+
+// posix_spawn can close the inherited fds itself since glibc 2.34.
+#if defined(__GLIBC__) && __GLIBC_PREREQ(2, 34)
+#define HAVE_SPAWN_CLOSEFROM 1
+#endif
+
+typedef struct _PendingLaunch {
+    char* name;
+    GPid pid;
+    gint64 start;
+    gint64 resolved; // right before the spawn
+    gint64 spawned;
+    guint timeout_id;
+} PendingLaunch;
+
+static GdkAppLaunchContext* _context = NULL;
+static GList* _pending = NULL;
+/* windows in _NET_CLIENT_LIST already checked for a launched pid */
+static GHashTable* _known_windows = NULL;
+
+static struct {
+    guint launches;
+    guint mapped;
+    guint timeouts;
+    gint64 total_mapped; // microseconds
+    gint64 max_mapped;
+    gint64 max_spawn;
+} _stats = { 0, 0, 0, 0, 0, 0 };
+
+
+/*
+ * The launch context is created once, only the icon changes per launch.
+ */
+static GAppLaunchContext* _get_launch_context(GAppInfo* app)
+{
+    if (_context == NULL) {
+        _context = gdk_display_get_app_launch_context(gdk_display_get_default());
+        //must set this otherwise termiator will not work properly
+        gdk_app_launch_context_set_screen(_context, gdk_screen_get_default());
+    }
+    gdk_app_launch_context_set_icon(_context, app != NULL ? g_app_info_get_icon(app) : NULL);
+    return G_APP_LAUNCH_CONTEXT(_context);
+}
+
+
+static void _client_list_changed(XPropertyEvent* event, gpointer user_data);
+
+
+static void _child_exited(GPid pid, gint status G_GNUC_UNUSED, gpointer user_data G_GNUC_UNUSED)
+{
+    g_spawn_close_pid(pid);
+}
+
+
+static void _finish_launch(PendingLaunch* launch, gint64 mapped)
+{
+    if (mapped != -1) {
+        _stats.mapped++;
+        _stats.total_mapped += mapped - launch->start;
+        _stats.max_mapped = MAX(_stats.max_mapped, mapped - launch->start);
+    } else {
+        _stats.timeouts++;
+    }
+
+    js_signal_begin("launch_timing");
+    js_signal_add_string("name", launch->name);
+    js_signal_add_int("pid", launch->pid);
+    js_signal_add_int("resolve", launch->resolved - launch->start);
+    js_signal_add_int("spawn", launch->spawned - launch->resolved);
+    js_signal_add_int("mapped", mapped != -1 ? mapped - launch->start : -1);
+    js_signal_end();
+
+    g_debug("[%s] %s: resolve %" G_GINT64_FORMAT "us, spawn %" G_GINT64_FORMAT "us, mapped %" G_GINT64_FORMAT "us",
+            __func__, launch->name, launch->resolved - launch->start,
+            launch->spawned - launch->resolved, mapped != -1 ? mapped - launch->start : -1);
+
+    _pending = g_list_remove(_pending, launch);
+    if (launch->timeout_id != 0)
+        g_source_remove(launch->timeout_id);
+    g_free(launch->name);
+    g_slice_free(PendingLaunch, launch);
+
+    if (_pending == NULL) {
+        unwatch_root_property(ATOM_NET_CLIENT_LIST, _client_list_changed, NULL);
+        g_hash_table_unref(_known_windows);
+        _known_windows = NULL;
+    }
+}
+
+
+static gboolean _map_timeout(PendingLaunch* launch)
+{
+    launch->timeout_id = 0;
+    _finish_launch(launch, -1);
+    return FALSE;
+}
+
+
+static Window* _get_client_list(Display* dpy, gulong* n)
+{
+    Window* clients = get_window_property(dpy, GDK_ROOT_WINDOW(), get_atom(ATOM_NET_CLIENT_LIST), n);
+    if (clients == NULL)
+        *n = 0;
+    return clients;
+}
+
+
+/*
+ * Only the windows which showed up since the last change are asked for
+ * their _NET_WM_PID.
+ */
+static void _client_list_changed(XPropertyEvent* event G_GNUC_UNUSED, gpointer user_data G_GNUC_UNUSED)
+{
+    gint64 now = g_get_monotonic_time();
+    Display* dpy = gdk_x11_get_default_xdisplay();
+    gulong n = 0;
+    Window* clients = _get_client_list(dpy, &n);
+
+    for (gulong i = 0; i < n && _pending != NULL; ++i) {
+        Window win = X_FETCH_32(clients, i);
+        if (g_hash_table_contains(_known_windows, GSIZE_TO_POINTER(win)))
+            continue;
+        g_hash_table_add(_known_windows, GSIZE_TO_POINTER(win));
+
+        gulong pid = 0;
+        if (!get_atom_value_by_atom(dpy, win, get_atom(ATOM_NET_WM_PID), &pid,
+                                    get_atom_value_for_index, 0))
+            continue;
+
+        for (GList* l = _pending; l != NULL; l = l->next) {
+            PendingLaunch* launch = l->data;
+            if ((gulong)launch->pid == pid) {
+                _finish_launch(launch, now);
+                break;
+            }
+        }
+    }
+
+    if (clients != NULL)
+        XFree(clients);
+}
+
+
+static void _track_launch(const char* name, GPid pid, gint64 start, gint64 resolved)
+{
+    PendingLaunch* launch = g_slice_new0(PendingLaunch);
+    launch->name = g_strdup(name);
+    launch->pid = pid;
+    launch->start = start;
+    launch->resolved = resolved;
+    launch->spawned = g_get_monotonic_time();
+    _stats.launches++;
+    _stats.max_spawn = MAX(_stats.max_spawn, launch->spawned - resolved);
+    launch->timeout_id = g_timeout_add_seconds(LAUNCH_MAP_TIMEOUT_SEC, (GSourceFunc)_map_timeout, launch);
+
+    if (_pending == NULL) {
+        // remember the existing windows so they are not asked for their pid.
+        _known_windows = g_hash_table_new(g_direct_hash, g_direct_equal);
+        gulong n = 0;
+        Window* clients = _get_client_list(gdk_x11_get_default_xdisplay(), &n);
+        for (gulong i = 0; i < n; ++i)
+            g_hash_table_add(_known_windows, GSIZE_TO_POINTER(X_FETCH_32(clients, i)));
+        if (clients != NULL)
+            XFree(clients);
+
+        watch_root_property(ATOM_NET_CLIENT_LIST, _client_list_changed, NULL);
+    }
+    _pending = g_list_prepend(_pending, launch);
+
+    // nothing else reaps the children, neither posix_spawn nor g_spawn with
+    // G_SPAWN_DO_NOT_REAP_CHILD.
+    g_child_watch_add(pid, _child_exited, NULL);
+}
+
+
+typedef struct _LaunchTiming {
+    gint64 start;
+    gint64 resolved;
+} LaunchTiming;
+
+
+static void _app_launched(GDesktopAppInfo* app, GPid pid, LaunchTiming* timing)
+{
+    _track_launch(g_app_info_get_name(G_APP_INFO(app)), pid, timing->start, timing->resolved);
+}
+
+
+gboolean launch_service_launch_app(GAppInfo* app, GList* files, gint64 start)
+{
+    GAppLaunchContext* context = _get_launch_context(app);
+    GError* error = NULL;
+    gboolean ret = FALSE;
+
+    if (!G_IS_DESKTOP_APP_INFO(app)) {
+        ret = g_app_info_launch(app, files, context, &error);
+    } else {
+        GList* uris = NULL;
+        for (GList* l = files; l != NULL; l = l->next)
+            uris = g_list_prepend(uris, g_file_get_uri(l->data));
+        uris = g_list_reverse(uris);
+
+        // glib forks and execs here: it only uses posix_spawn with
+        // G_SPAWN_LEAVE_DESCRIPTORS_OPEN, and not every fd of this process
+        // (X, sqlite, the webview) is close-on-exec.
+        LaunchTiming timing = { start, g_get_monotonic_time() };
+        ret = g_desktop_app_info_launch_uris_as_manager(G_DESKTOP_APP_INFO(app), uris, context,
+                                                        G_SPAWN_SEARCH_PATH | G_SPAWN_DO_NOT_REAP_CHILD,
+                                                        NULL, NULL,
+                                                        (GDesktopAppLaunchCallback)_app_launched, &timing,
+                                                        &error);
+        g_list_free_full(uris, g_free);
+    }
+
+    if (error != NULL) {
+        g_warning("[%s] launch %s failed: %s", __func__, g_app_info_get_name(app), error->message);
+        g_error_free(error);
+    }
+    return ret;
+}
+
+
+#ifdef HAVE_SPAWN_CLOSEFROM
+/*
+ * posix_spawn @path with only stdin, stdout and stderr inherited, no signal
+ * blocked and SIGPIPE back to its default. Return an errno value.
+ */
+static int _posix_spawn(GPid* pid, const char* path, char* const argv[])
+{
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_addclosefrom_np(&actions, STDERR_FILENO + 1);
+
+    posix_spawnattr_t attr;
+    posix_spawnattr_init(&attr);
+    sigset_t signals;
+    sigemptyset(&signals);
+    posix_spawnattr_setsigmask(&attr, &signals);
+    sigaddset(&signals, SIGPIPE);
+    posix_spawnattr_setsigdefault(&attr, &signals);
+    posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF);
+
+    int err = posix_spawn(pid, path, &actions, &attr, argv, environ);
+
+    posix_spawnattr_destroy(&attr);
+    posix_spawn_file_actions_destroy(&actions);
+    return err;
+}
+
+
+static gboolean _spawn(char* const argv[], GPid* pid)
+{
+    char* path = g_find_program_in_path(argv[0]);
+    if (path == NULL) {
+        g_warning("[%s] spawn %s failed: %s", __func__, argv[0], g_strerror(ENOENT));
+        return FALSE;
+    }
+
+    int err = _posix_spawn(pid, path, argv);
+    if (err == ENOEXEC) {
+        // a script without a shebang, run it through /bin/sh like execvp.
+        guint argc = g_strv_length((gchar**)argv);
+        char** sh_argv = g_new0(char*, argc + 2);
+        sh_argv[0] = "/bin/sh";
+        sh_argv[1] = path;
+        for (guint i = 1; i < argc; ++i)
+            sh_argv[i + 1] = argv[i];
+        err = _posix_spawn(pid, "/bin/sh", sh_argv);
+        g_free(sh_argv);
+    }
+
+    if (err != 0)
+        g_warning("[%s] spawn %s failed: %s", __func__, path, g_strerror(err));
+    g_free(path);
+    return err == 0;
+}
+#else
+static gboolean _spawn(char* const argv[], GPid* pid)
+{
+    // closes the inherited fds and runs scripts without a shebang through
+    // /bin/sh too, but by fork and exec.
+    GError* error = NULL;
+    if (!g_spawn_async(NULL, (gchar**)argv, NULL,
+                       G_SPAWN_SEARCH_PATH | G_SPAWN_DO_NOT_REAP_CHILD,
+                       NULL, NULL, pid, &error)) {
+        g_warning("[%s] spawn %s failed: %s", __func__, argv[0], error->message);
+        g_error_free(error);
+        return FALSE;
+    }
+    return TRUE;
+}
+#endif
+
+
+gboolean launch_service_spawn(char* const argv[], gint64 start)
+{
+    gint64 resolved = g_get_monotonic_time();
+    GPid pid = 0;
+    if (!_spawn(argv, &pid))
+        return FALSE;
+
+    char* name = g_path_get_basename(argv[0]);
+    _track_launch(name, pid, start, resolved);
+    g_free(name);
+
+    return TRUE;
+}
+
+
+static void _collect_stats(json_object* stats)
+{
+    json_object_object_add(stats, "launches", json_object_new_int(_stats.launches));
+    json_object_object_add(stats, "mapped", json_object_new_int(_stats.mapped));
+    json_object_object_add(stats, "timeouts", json_object_new_int(_stats.timeouts));
+    json_object_object_add(stats, "avg_mapped_us",
+                           json_object_new_int64(_stats.mapped ? _stats.total_mapped / _stats.mapped : 0));
+    json_object_object_add(stats, "max_mapped_us", json_object_new_int64(_stats.max_mapped));
+    json_object_object_add(stats, "max_spawn_us", json_object_new_int64(_stats.max_spawn));
+}
+
+
+static void _register_stats() __attribute__((constructor));
+
+void _register_stats()
+{
+    perf_stats_register("launch", _collect_stats);
+}
+
+
+static void _unregister_stats() __attribute__((destructor));
+
+void _unregister_stats()
+{
+    perf_stats_unregister("launch");
+}
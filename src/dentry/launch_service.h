@@ -0,0 +1,14 @@
+#ifndef _LAUNCH_SERVICE_H_
+#define _LAUNCH_SERVICE_H_
+
+#include <gio/gio.h>
+
+/*
+ * Launch apps and executables, timing each launch from @start (a
+ * g_get_monotonic_time value taken when the request came in) until its
+ * first window is mapped. The timings are posted as "launch_timing".
+ */
+gboolean launch_service_launch_app(GAppInfo* app, GList* files, gint64 start);
+gboolean launch_service_spawn(char* const argv[], gint64 start);
+
+#endif
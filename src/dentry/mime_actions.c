@@ -3,6 +3,7 @@
 #include <gtk/gtk.h>
 
 #include "common/xdg_misc.h"
+#include "launch_service.h"
 
 /*#define TERMINAL_SCHEMA_ID "com.deepin.desktop.default-applications.terminal"*/
 /*#define TERMINAL_KEY_EXEC  "exec"*/
@@ -54,8 +55,7 @@ GAppInfo *gen_app_info (const char* executable)
 gboolean exec_app_info (const char *executable)
 {
     GAppInfo *appinfo = NULL;
-    GError *error = NULL;
-    gboolean is_ok __attribute__((unused)) = FALSE;
+    gboolean is_ok = FALSE;
 
     appinfo = gen_app_info (executable);
     if ( appinfo == NULL ) {
@@ -63,21 +63,10 @@ gboolean exec_app_info (const char *executable)
         return FALSE;
     }
 
-    GdkAppLaunchContext* ctx = gdk_display_get_app_launch_context(gdk_display_get_default());
-    gdk_app_launch_context_set_screen(ctx, gdk_screen_get_default()); //must set this otherwise termiator will not work properly
-    is_ok = g_app_info_launch (appinfo, NULL, (GAppLaunchContext*)ctx, &error);
-    g_object_unref(ctx);
-    if (error!=NULL)
-    {
-        g_debug("exec app info error: %s", error->message);
-        g_error_free(error);
-        g_object_unref (appinfo);
-
-        return FALSE;
-    }
-
+    is_ok = launch_service_launch_app (appinfo, NULL, g_get_monotonic_time());
     g_object_unref (appinfo);
-    return TRUE;
+
+    return is_ok;
 }
 
 void desktop_run_in_terminal(char* executable)
@@ -100,7 +89,7 @@ void desktop_run_in_terminal(char* executable)
 static void
 run_file  (GFile* file, GFile* _file_arg)
 {
-    char* cmd_line = NULL;
+    gint64 start = g_get_monotonic_time();
     char* file_path = NULL;
 
 
@@ -124,26 +113,19 @@ run_file  (GFile* file, GFile* _file_arg)
     }
     g_debug("run file_path :%s",file_path);
 
-    if (_file_arg != NULL)
-    {
-        char* _file_arg_uri = g_file_get_uri (_file_arg);
-        cmd_line = g_strdup_printf ("%s %s", file_path, _file_arg_uri);
-	g_free (_file_arg_uri);
-    }
-    else
-    {
-        cmd_line = g_strdup (file_path);
-    }
-    g_free (file_path);
-    if(cmd_line != NULL)
-    {
-        g_spawn_command_line_async (cmd_line, NULL);
-    }
-    else
+    if (file_path == NULL)
     {
         g_warning("run file_path is null");
+        return;
     }
-    g_free (cmd_line);
+
+    // spawn the file directly, paths with spaces used to be split by the
+    // shell parsing of g_spawn_command_line_async.
+    char* _file_arg_uri = _file_arg != NULL ? g_file_get_uri (_file_arg) : NULL;
+    char* argv[] = { file_path, _file_arg_uri, NULL };
+    launch_service_spawn (argv, start);
+    g_free (_file_arg_uri);
+    g_free (file_path);
 }
 
 void desktop_run_in_terminal(char* executable);
@@ -158,10 +140,13 @@ run_file_in_terminal (GFile* file)
 static gboolean
 display_file (GFile* file, const char* content_type)
 {
+    gint64 start = g_get_monotonic_time();
     gboolean res = TRUE;
     GAppInfo *app  = g_app_info_get_default_for_type(content_type, FALSE);
+    if (app == NULL)
+        return FALSE;
     GList* list = g_list_append(NULL, file);
-    res = g_app_info_launch(app, list, NULL, NULL);
+    res = launch_service_launch_app(app, list, start);
     g_list_free(list);
     g_object_unref(app);
 
@@ -0,0 +1,386 @@
+/**
+ * Copyright (c) 2011 ~ 2014 Deepin, Inc.
+ *               2011 ~ 2014 snyh
+ *
+ * Author:      snyh <snyh@snyh.org>
+ * Maintainer:  snyh <snyh@snyh.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ **/
+#define _GNU_SOURCE
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/syscall.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <gdk-pixbuf/gdk-pixbuf.h>
+
+#include "dcore/perf_stats.h"
+#include "thumbnailer_executor.h"
+
+// a thumbnailer is killed when it runs longer than this.
+#define THUMBNAILER_TIMEOUT_MS 10000
+// external thumbnailers running at the same time for one mime type.
+#define THUMBNAILER_MAX_PER_MIME 2
+// how long to wait for a free slot before giving up on the thumbnailer.
+#define THUMBNAILER_QUEUE_WAIT_US (2 * G_TIME_SPAN_SECOND)
+// a thumbnailer timing out this many times in a row is skipped for a while.
+#define THUMBNAILER_MAX_TIMEOUTS 3
+#define THUMBNAILER_COOLDOWN_US (60 * G_TIME_SPAN_SECOND)
+
+#define THUMBNAILER_READ_SIZE 65536
+
+#ifndef MFD_CLOEXEC
+#define MFD_CLOEXEC 0x0001U
+#endif
+
+typedef struct _ThumbnailerRecord {
+    ThumbnailerStats stats;
+    guint consecutive_timeouts;
+    gint64 disabled_until;
+} ThumbnailerRecord;
+
+typedef struct _ChildWait {
+    gboolean exited;
+    gboolean timed_out;
+    int status;
+} ChildWait;
+
+static GMutex _lock;
+static GCond _slot_cond;
+/* interned mime type -> running thumbnailers */
+static GHashTable* _running = NULL;
+/* thumbnailer name -> ThumbnailerRecord */
+static GHashTable* _records = NULL;
+
+
+gboolean thumbnailer_output_open(ThumbnailerOutput* output)
+{
+#ifdef SYS_memfd_create
+    output->fd = syscall(SYS_memfd_create, "thumbnail", MFD_CLOEXEC);
+    if (output->fd != -1) {
+        output->path = g_strdup_printf("/dev/fd/%d", output->fd);
+        output->is_memfd = TRUE;
+        return TRUE;
+    }
+#endif
+
+    output->is_memfd = FALSE;
+    output->fd = g_file_open_tmp(".gnome_desktop_thumbnail.XXXXXX", &output->path, NULL);
+    return output->fd != -1;
+}
+
+
+void thumbnailer_output_close(ThumbnailerOutput* output)
+{
+    close(output->fd);
+    if (!output->is_memfd)
+        g_unlink(output->path);
+    g_free(output->path);
+    output->path = NULL;
+    output->fd = -1;
+}
+
+
+static GdkPixbuf* _load_output(ThumbnailerOutput* output)
+{
+    if (!output->is_memfd)
+        return gdk_pixbuf_new_from_file(output->path, NULL);
+
+    if (lseek(output->fd, 0, SEEK_SET) != 0)
+        return NULL;
+
+    GdkPixbufLoader* loader = gdk_pixbuf_loader_new();
+    guchar* buf = g_malloc(THUMBNAILER_READ_SIZE);
+    gboolean ok = TRUE;
+    gssize n = 0;
+    while ((n = read(output->fd, buf, THUMBNAILER_READ_SIZE)) > 0) {
+        if (!gdk_pixbuf_loader_write(loader, buf, n, NULL)) {
+            ok = FALSE;
+            break;
+        }
+    }
+    g_free(buf);
+
+    ok = gdk_pixbuf_loader_close(loader, NULL) && ok && n == 0;
+
+    GdkPixbuf* pixbuf = NULL;
+    if (ok && gdk_pixbuf_loader_get_pixbuf(loader) != NULL)
+        pixbuf = g_object_ref(gdk_pixbuf_loader_get_pixbuf(loader));
+    g_object_unref(loader);
+
+    return pixbuf;
+}
+
+
+static ThumbnailerRecord* _get_record(const char* name)
+{
+    if (_records == NULL)
+        _records = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+
+    ThumbnailerRecord* record = g_hash_table_lookup(_records, name);
+    if (record == NULL) {
+        record = g_new0(ThumbnailerRecord, 1);
+        g_hash_table_insert(_records, g_strdup(name), record);
+    }
+    return record;
+}
+
+
+static gboolean _acquire_slot(const char* mime_type)
+{
+    gint64 end_time = g_get_monotonic_time() + THUMBNAILER_QUEUE_WAIT_US;
+
+    g_mutex_lock(&_lock);
+    if (_running == NULL)
+        _running = g_hash_table_new(g_direct_hash, g_direct_equal);
+
+    while (GPOINTER_TO_UINT(g_hash_table_lookup(_running, mime_type)) >= THUMBNAILER_MAX_PER_MIME) {
+        if (!g_cond_wait_until(&_slot_cond, &_lock, end_time)) {
+            g_mutex_unlock(&_lock);
+            return FALSE;
+        }
+    }
+
+    guint count = GPOINTER_TO_UINT(g_hash_table_lookup(_running, mime_type));
+    g_hash_table_insert(_running, (gpointer)mime_type, GUINT_TO_POINTER(count + 1));
+    g_mutex_unlock(&_lock);
+
+    return TRUE;
+}
+
+
+static void _release_slot(const char* mime_type)
+{
+    g_mutex_lock(&_lock);
+    guint count = GPOINTER_TO_UINT(g_hash_table_lookup(_running, mime_type));
+    if (count <= 1)
+        g_hash_table_remove(_running, mime_type);
+    else
+        g_hash_table_insert(_running, (gpointer)mime_type, GUINT_TO_POINTER(count - 1));
+    g_cond_broadcast(&_slot_cond);
+    g_mutex_unlock(&_lock);
+}
+
+
+/*
+ * Run in the child before exec: put it in its own process group so a timeout
+ * kills the helpers a script starts too, and let the output memfd survive
+ * the exec.
+ */
+static void _child_setup(gpointer user_data)
+{
+    int output_fd = GPOINTER_TO_INT(user_data);
+
+    setpgid(0, 0);
+    if (output_fd != -1)
+        fcntl(output_fd, F_SETFD, 0);
+}
+
+
+static void _child_exited(GPid pid, gint status, gpointer user_data)
+{
+    ChildWait* wait = user_data;
+    wait->status = status;
+    wait->exited = TRUE;
+    g_spawn_close_pid(pid);
+}
+
+
+static gboolean _child_timeout(gpointer user_data)
+{
+    ChildWait* wait = user_data;
+    wait->timed_out = TRUE;
+    return FALSE;
+}
+
+
+/*
+ * Wait for @pid in a private main context, so the caller's main loop is not
+ * re-entered, and kill its process group when it runs out of time.
+ */
+static void _wait_child(GPid pid, ChildWait* wait)
+{
+    GMainContext* context = g_main_context_new();
+
+    GSource* child_source = g_child_watch_source_new(pid);
+    g_source_set_callback(child_source, (GSourceFunc)_child_exited, wait, NULL);
+    g_source_attach(child_source, context);
+
+    GSource* timeout_source = g_timeout_source_new(THUMBNAILER_TIMEOUT_MS);
+    g_source_set_callback(timeout_source, _child_timeout, wait, NULL);
+    g_source_attach(timeout_source, context);
+
+    gboolean killed = FALSE;
+    while (!wait->exited) {
+        g_main_context_iteration(context, TRUE);
+        if (wait->timed_out && !killed) {
+            kill(-pid, SIGKILL);
+            kill(pid, SIGKILL);
+            killed = TRUE;
+        }
+    }
+
+    g_source_destroy(timeout_source);
+    g_source_unref(timeout_source);
+    g_source_destroy(child_source);
+    g_source_unref(child_source);
+    g_main_context_unref(context);
+}
+
+
+static void _update_stats(const char* name, gint64 elapsed, gboolean timed_out, gboolean failed)
+{
+    g_mutex_lock(&_lock);
+    ThumbnailerRecord* record = _get_record(name);
+
+    record->stats.runs++;
+    record->stats.total_time += elapsed;
+    if (elapsed > record->stats.max_time)
+        record->stats.max_time = elapsed;
+
+    if (timed_out) {
+        record->stats.timeouts++;
+        if (++record->consecutive_timeouts >= THUMBNAILER_MAX_TIMEOUTS) {
+            g_warning("[%s] %s timed out %u times, skip it for a while",
+                      __func__, name, record->consecutive_timeouts);
+            record->disabled_until = g_get_monotonic_time() + THUMBNAILER_COOLDOWN_US;
+            record->consecutive_timeouts = 0;
+        }
+    } else {
+        record->consecutive_timeouts = 0;
+        if (failed)
+            record->stats.failures++;
+    }
+    g_mutex_unlock(&_lock);
+}
+
+
+/*
+ * Run the expanded thumbnailer @command_line and load the png it writes to
+ * @output. At most THUMBNAILER_MAX_PER_MIME thumbnailers run for the same
+ * @mime_type; when no slot frees up in time, or the thumbnailer keeps timing
+ * out, NULL is returned right away so the caller can fall back to gdk-pixbuf.
+ */
+GdkPixbuf* thumbnailer_executor_run(const char* name, const char* mime_type,
+                                    const char* command_line,
+                                    ThumbnailerOutput* output)
+{
+    mime_type = g_intern_string(mime_type);
+
+    g_mutex_lock(&_lock);
+    gboolean disabled = _get_record(name)->disabled_until > g_get_monotonic_time();
+    g_mutex_unlock(&_lock);
+    if (disabled) {
+        g_debug("[%s] %s is cooling down", __func__, name);
+        return NULL;
+    }
+
+    char** argv = NULL;
+    if (!g_shell_parse_argv(command_line, NULL, &argv, NULL))
+        return NULL;
+
+    if (!_acquire_slot(mime_type)) {
+        g_debug("[%s] too many thumbnailers for %s", __func__, mime_type);
+        g_mutex_lock(&_lock);
+        _get_record(name)->stats.busy++;
+        g_mutex_unlock(&_lock);
+        g_strfreev(argv);
+        return NULL;
+    }
+
+    gint64 start = g_get_monotonic_time();
+    ChildWait wait = { FALSE, FALSE, 0 };
+    GPid pid;
+    GError* error = NULL;
+    gboolean spawned = g_spawn_async(NULL, argv, NULL,
+                                     G_SPAWN_SEARCH_PATH | G_SPAWN_DO_NOT_REAP_CHILD,
+                                     _child_setup,
+                                     GINT_TO_POINTER(output->is_memfd ? output->fd : -1),
+                                     &pid, &error);
+    g_strfreev(argv);
+
+    if (spawned) {
+        _wait_child(pid, &wait);
+    } else {
+        g_warning("[%s] spawn %s failed: %s", __func__, name, error->message);
+        g_error_free(error);
+    }
+    _release_slot(mime_type);
+
+    GdkPixbuf* pixbuf = NULL;
+    if (spawned && !wait.timed_out && WIFEXITED(wait.status) && WEXITSTATUS(wait.status) == 0)
+        pixbuf = _load_output(output);
+
+    _update_stats(name, g_get_monotonic_time() - start, wait.timed_out, pixbuf == NULL);
+
+    return pixbuf;
+}
+
+
+gboolean thumbnailer_executor_get_stats(const char* name, ThumbnailerStats* stats)
+{
+    g_mutex_lock(&_lock);
+    ThumbnailerRecord* record = _records ? g_hash_table_lookup(_records, name) : NULL;
+    if (record != NULL)
+        *stats = record->stats;
+    g_mutex_unlock(&_lock);
+
+    return record != NULL;
+}
+
+
+static void _collect_stats(json_object* stats)
+{
+    g_mutex_lock(&_lock);
+    if (_records != NULL) {
+        GHashTableIter iter;
+        gpointer name, value;
+        g_hash_table_iter_init(&iter, _records);
+        while (g_hash_table_iter_next(&iter, &name, &value)) {
+            ThumbnailerStats* s = &((ThumbnailerRecord*)value)->stats;
+            json_object* record = json_object_new_object();
+            json_object_object_add(record, "runs", json_object_new_int(s->runs));
+            json_object_object_add(record, "failures", json_object_new_int(s->failures));
+            json_object_object_add(record, "timeouts", json_object_new_int(s->timeouts));
+            json_object_object_add(record, "busy", json_object_new_int(s->busy));
+            json_object_object_add(record, "avg_time_us",
+                                   json_object_new_int64(s->runs ? s->total_time / s->runs : 0));
+            json_object_object_add(record, "max_time_us", json_object_new_int64(s->max_time));
+            json_object_object_add(stats, name, record);
+        }
+    }
+    g_mutex_unlock(&_lock);
+}
+
+
+static void _register_stats() __attribute__((constructor));
+
+void _register_stats()
+{
+    perf_stats_register("thumbnailer", _collect_stats);
+}
+
+
+static void _unregister_stats() __attribute__((destructor));
+
+void _unregister_stats()
+{
+    perf_stats_unregister("thumbnailer");
+}
+
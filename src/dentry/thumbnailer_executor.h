@@ -0,0 +1,32 @@
+#ifndef _THUMBNAILER_EXECUTOR_H_
+#define _THUMBNAILER_EXECUTOR_H_
+
+#include <glib.h>
+#include <gdk-pixbuf/gdk-pixbuf.h>
+
+// where an external thumbnailer writes its png, passed as %o.
+typedef struct _ThumbnailerOutput {
+    int fd;
+    char* path;
+    gboolean is_memfd;
+} ThumbnailerOutput;
+
+typedef struct _ThumbnailerStats {
+    guint runs;
+    guint failures;
+    guint timeouts;
+    guint busy; // skipped because the mime type was at its concurrency cap
+    gint64 total_time; // microseconds
+    gint64 max_time; // microseconds
+} ThumbnailerStats;
+
+gboolean thumbnailer_output_open (ThumbnailerOutput* output);
+void thumbnailer_output_close (ThumbnailerOutput* output);
+
+// @name identifies the thumbnailer in the stats, e.g. its .thumbnailer file.
+GdkPixbuf* thumbnailer_executor_run (const char* name, const char* mime_type,
+                                     const char* command_line,
+                                     ThumbnailerOutput* output);
+gboolean thumbnailer_executor_get_stats (const char* name, ThumbnailerStats* stats);
+
+#endif
@@ -2,14 +2,17 @@
 
 #define GNOME_DESKTOP_USE_UNSTABLE_API
 #include "gnome-desktop-thumbnail.h"
+#include "content_type_cache.h"
 
 static GnomeDesktopThumbnailFactory *
 get_thumbnail_factory ()
 {
     static GnomeDesktopThumbnailFactory *thumbnail_factory = NULL;
 
-    if (thumbnail_factory == NULL) {
-        thumbnail_factory = gnome_desktop_thumbnail_factory_new (GNOME_DESKTOP_THUMBNAIL_SIZE_NORMAL);
+    // dentry_get_thumbnail runs on the binding worker threads.
+    if (g_once_init_enter (&thumbnail_factory)) {
+        g_once_init_leave (&thumbnail_factory,
+                           gnome_desktop_thumbnail_factory_new (GNOME_DESKTOP_THUMBNAIL_SIZE_NORMAL));
     }
 
     return thumbnail_factory;
@@ -21,34 +24,32 @@ gfile_can_thumbnail (GFile* file)
     GnomeDesktopThumbnailFactory *factory;
     gboolean can_thumbnail;
     char* uri;
-    GFileInfo* info;
-    time_t mtime;
-    const char* content_type;
-    char* mime_type;
-
-    uri = g_file_get_uri (file);
+    FileTypeInfo type_info;
 
-    info = g_file_query_info (file, "standard::content-type,time::modified",
-                              G_FILE_QUERY_INFO_NONE,
-                              NULL, NULL);
-    content_type = g_file_info_get_content_type (info);
-    mime_type = g_content_type_get_mime_type (content_type);
+    if (!gfile_query_type_info (file, G_FILE_QUERY_INFO_NONE, &type_info))
+        return FALSE;
 
-    mtime = g_file_info_get_attribute_uint64(info, "time::modified");
-    g_object_unref (info);
+    uri = g_file_get_uri (file);
 
     factory = get_thumbnail_factory ();
     //1' check if we can thumbnail
     can_thumbnail = gnome_desktop_thumbnail_factory_can_thumbnail (factory,
                                                          uri,
-                                                         mime_type,
-                                                         mtime);
-    g_debug ("%s can thumbnail(mime: %s): %d", uri, mime_type, can_thumbnail);
+                                                         type_info.mime_type,
+                                                         type_info.mtime);
+    g_debug ("%s can thumbnail(mime: %s): %d", uri, type_info.mime_type, can_thumbnail);
     g_free (uri);
-    g_free (mime_type);
 
     return can_thumbnail;
 }
+gboolean
+uri_can_thumbnail (const char* uri, const char* mime_type, time_t mtime)
+{
+    return gnome_desktop_thumbnail_factory_can_thumbnail (get_thumbnail_factory (),
+                                                          uri,
+                                                          mime_type,
+                                                          mtime);
+}
 /*
  *      syncronously create thumbnails. shall we move to a threaded
  *      implementation?
@@ -62,21 +63,16 @@ gfile_lookup_thumbnail (GFile* file)
     GnomeDesktopThumbnailFactory *factory;
     //gboolean can_thumbnail;
     char* uri;
-    GFileInfo* info;
+    FileTypeInfo type_info;
     time_t mtime;
-    const char* content_type;
-    char* mime_type;
+    const char* mime_type;
 
-    uri = g_file_get_uri (file);
-
-    info = g_file_query_info (file, "standard::content-type,time::modified",
-                              G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS,
-                              NULL, NULL);
-    content_type = g_file_info_get_content_type (info);
-    mime_type = g_content_type_get_mime_type (content_type);
+    if (!gfile_query_type_info (file, G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS, &type_info))
+        return NULL;
 
-    mtime = g_file_info_get_attribute_uint64(info, "time::modified");
-    g_object_unref (info);
+    uri = g_file_get_uri (file);
+    mime_type = type_info.mime_type;
+    mtime = type_info.mtime;
 
     factory = get_thumbnail_factory ();
 #if 0
@@ -89,7 +85,6 @@ gfile_lookup_thumbnail (GFile* file)
     if (can_thumbnail == FALSE)
     {
 	g_free (uri);
-	g_free (mime_type);
 	return NULL;
     }
 #endif
@@ -104,6 +99,7 @@ gfile_lookup_thumbnail (GFile* file)
         time (&current_time);
         if (current_time - mtime < THUMBNAIL_CREATION_DELAY)
         {
+            g_free (uri);
             return NULL;
         }
         //try to create thumbnails
@@ -122,7 +118,6 @@ gfile_lookup_thumbnail (GFile* file)
         thumbnail_path = gnome_desktop_thumbnail_factory_lookup (factory, uri, mtime);
     }
     g_free (uri);
-    g_free (mime_type);
 
     g_debug ("thumbnail_path: %s", thumbnail_path);
 
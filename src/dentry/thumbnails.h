@@ -1,7 +1,11 @@
 #ifndef _THUMBNAILS_H_
 #define _THUMBNAILS_H_
 
+#include <time.h>
+#include <gio/gio.h>
+
 gboolean gfile_can_thumbnail (GFile* file);
+gboolean uri_can_thumbnail (const char* uri, const char* mime_type, time_t mtime);
 char*    gfile_lookup_thumbnail (GFile* file);
 
 #endif 
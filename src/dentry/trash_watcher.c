@@ -0,0 +1,197 @@
+/**
+ * Copyright (c) 2011 ~ 2012 Deepin, Inc.
+ *               2011 ~ 2012 snyh
+ *
+ * Author:      snyh <snyh@snyh.org>
+ * Maintainer:  snyh <snyh@snyh.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ **/
+#include <gio/gio.h>
+
+#include "dcore/signal.h"
+#include "trash_watcher.h"
+
+/*
+ * The trash item count is tracked from the monitor events instead of asking
+ * gvfs for G_FILE_ATTRIBUTE_TRASH_ITEM_COUNT on every change, which made
+ * trashing 1000 files cost 1000 recounts. A full count is still done once
+ * the events settle to correct any drift, and "trash_count_changed" is
+ * posted at most every TRASH_SIGNAL_INTERVAL_MS.
+ */
+
+#define TRASH_SIGNAL_INTERVAL_MS 200
+// quiet time before the tracked count is checked against a full count.
+#define TRASH_RECONCILE_DELAY_MS 2000
+
+static GFile* _trash_can = NULL;
+static GFileMonitor* _monitor = NULL;
+
+static guint _count = 0;
+static gint64 _posted_count = -1;
+static gint64 _last_post = 0;
+static guint _signal_id = 0;
+
+static guint _reconcile_id = 0;
+// bumped on every change, a full count started before a change is stale.
+static guint _generation = 0;
+
+
+static guint _query_count()
+{
+    guint count = 0;
+    GFileInfo* info = g_file_query_info(_trash_can, G_FILE_ATTRIBUTE_TRASH_ITEM_COUNT,
+                                        G_FILE_QUERY_INFO_NONE, NULL, NULL);
+    // info maybe equal NULL when use xinit run desktop
+    if (info != NULL) {
+        count = g_file_info_get_attribute_uint32(info, G_FILE_ATTRIBUTE_TRASH_ITEM_COUNT);
+        g_object_unref(info);
+    }
+    return count;
+}
+
+
+static gboolean _post_count(gpointer user_data G_GNUC_UNUSED)
+{
+    _signal_id = 0;
+    if (_posted_count == _count)
+        return FALSE;
+
+    _posted_count = _count;
+    _last_post = g_get_monotonic_time();
+    js_signal_begin("trash_count_changed");
+    js_signal_add_int("value", _count);
+    js_signal_end();
+    return FALSE;
+}
+
+
+static void _schedule_post()
+{
+    if (_signal_id != 0)
+        return;
+
+    gint64 since_last = (g_get_monotonic_time() - _last_post) / 1000;
+    if (since_last >= TRASH_SIGNAL_INTERVAL_MS)
+        _post_count(NULL);
+    else
+        _signal_id = g_timeout_add(TRASH_SIGNAL_INTERVAL_MS - since_last, _post_count, NULL);
+}
+
+
+static void _schedule_reconcile();
+
+
+static void _count_queried(GObject* source, GAsyncResult* res, gpointer user_data)
+{
+    guint generation = GPOINTER_TO_UINT(user_data);
+
+    GFileInfo* info = g_file_query_info_finish(G_FILE(source), res, NULL);
+    if (info == NULL)
+        return;
+    guint count = g_file_info_get_attribute_uint32(info, G_FILE_ATTRIBUTE_TRASH_ITEM_COUNT);
+    g_object_unref(info);
+
+    if (generation != _generation) {
+        // changed meanwhile, the events are counted already, check again later.
+        _schedule_reconcile();
+        return;
+    }
+
+    if (count != _count) {
+        g_debug("[%s] tracked %u trash items, but there are %u", __func__, _count, count);
+        _count = count;
+        _schedule_post();
+    }
+}
+
+
+static gboolean _reconcile(gpointer user_data G_GNUC_UNUSED)
+{
+    _reconcile_id = 0;
+    g_file_query_info_async(_trash_can, G_FILE_ATTRIBUTE_TRASH_ITEM_COUNT, G_FILE_QUERY_INFO_NONE,
+                            G_PRIORITY_LOW, NULL, _count_queried, GUINT_TO_POINTER(_generation));
+    return FALSE;
+}
+
+
+static void _schedule_reconcile()
+{
+    if (_reconcile_id != 0)
+        g_source_remove(_reconcile_id);
+    _reconcile_id = g_timeout_add(TRASH_RECONCILE_DELAY_MS, _reconcile, NULL);
+}
+
+
+static void _trash_changed(GFileMonitor* monitor G_GNUC_UNUSED, GFile* file,
+                           GFile* other_file G_GNUC_UNUSED, GFileMonitorEvent event_type,
+                           gpointer user_data G_GNUC_UNUSED)
+{
+    // only the top level items are counted, like TRASH_ITEM_COUNT does.
+    gboolean is_item = g_file_has_parent(file, _trash_can);
+
+    switch (event_type) {
+    case G_FILE_MONITOR_EVENT_CREATED:
+        if (!is_item)
+            return;
+        _count++;
+        break;
+    case G_FILE_MONITOR_EVENT_DELETED:
+        if (!is_item)
+            return;
+        if (_count > 0)
+            _count--;
+        break;
+    case G_FILE_MONITOR_EVENT_MOVED:
+        // a rename inside the trash, the count stays the same.
+        return;
+    case G_FILE_MONITOR_EVENT_UNMOUNTED:
+        // a whole trash dir went away, only a full count knows the result.
+        break;
+    default:
+        return;
+    }
+
+    _generation++;
+    _schedule_post();
+    _schedule_reconcile();
+}
+
+
+void trash_watcher_start()
+{
+    if (_monitor != NULL)
+        return;
+
+    if (_trash_can == NULL)
+        _trash_can = g_file_new_for_uri("trash:///");
+    _monitor = g_file_monitor_directory(_trash_can, G_FILE_MONITOR_SEND_MOVED, NULL, NULL);
+    if (_monitor == NULL)
+        return;
+    g_signal_connect(_monitor, "changed", G_CALLBACK(_trash_changed), NULL);
+
+    _count = _query_count();
+    _posted_count = _count;
+}
+
+
+guint trash_watcher_get_count()
+{
+    if (_monitor != NULL)
+        return _count;
+
+    if (_trash_can == NULL)
+        _trash_can = g_file_new_for_uri("trash:///");
+    return _query_count();
+}
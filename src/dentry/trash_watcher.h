@@ -0,0 +1,12 @@
+#ifndef _TRASH_WATCHER_H_
+#define _TRASH_WATCHER_H_
+
+#include <glib.h>
+
+// watch trash:/// and post "trash_count_changed", once per process.
+void trash_watcher_start();
+
+// the tracked count once started, otherwise a full count.
+guint trash_watcher_get_count();
+
+#endif
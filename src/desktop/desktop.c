@@ -36,9 +36,12 @@
 #include "common/pixbuf.h"
 #include "common/i18n.h"
 #include "common/utils.h"
+#include "common/config_store.h"
 #include "common/session_register.h"
 #include "common/display_info.h"
 #include "dentry/entry.h"
+#include "dentry/entry_cache.h"
+#include "dentry/desktop_names.h"
 #include "dcore/dcore.h"
 #include "inotify_item.h"
 #include "desktop_utils.h"
@@ -157,34 +160,25 @@ void desktop_test() {}
 JS_EXPORT_API
 ArrayContainer desktop_get_desktop_entries()
 {
-    //JSObjectRef array = json_array_create();
-    ArrayContainer array;
+    GPtrArray* entries = g_ptr_array_new();
     GDir* dir = g_dir_open(DESKTOP_DIR(), 0, NULL);
 
-    int count = 0;
     const char* file_name = NULL;
-    for (int i=0; NULL != (file_name = g_dir_read_name(dir));) {
-        if(desktop_file_filter(file_name))
-            continue;
-        count++;
-    }
-
-    array.num = count;
-    void** data = g_new0(void*, count);
-    array.data = (void*)data;
-    dir = g_dir_open(DESKTOP_DIR(), 0, NULL);
-    for (int i = 0; NULL != (file_name = g_dir_read_name(dir));) {
+    while (dir != NULL && NULL != (file_name = g_dir_read_name(dir))) {
         if(desktop_file_filter(file_name))
             continue;
         char* path = g_build_filename(DESKTOP_DIR(), file_name, NULL);
         Entry* e = dentry_create_by_path(path);
-        //printf("%d %s 0x%llx %p\n", __LINE__, path, (int64_t)e, e);
-        data[i++] = (void*)e;
+        g_ptr_array_add(entries, entry_cache_export(e));
+        g_object_unref(e);
         g_free(path);
-        //json_array_insert_nobject(array, i++, e, g_object_ref, g_object_unref);
-        //g_object_unref(e);
     }
-    g_dir_close(dir);
+    if (dir != NULL)
+        g_dir_close(dir);
+
+    ArrayContainer array;
+    array.num = entries->len;
+    array.data = g_ptr_array_free(entries, FALSE);
     return array;
 }
 
@@ -282,16 +276,7 @@ const char* desktop_get_desktop_path()
 GFile* _get_useable_file(const char* basename)
 {
     GFile* dir = g_file_new_for_path(DESKTOP_DIR());
-
-    char* name = g_strdup(basename);
-    GFile* child = g_file_get_child(dir, name);
-    for (int i=0; g_file_query_exists(child, NULL); i++) {
-        g_object_unref(child);
-        g_free(name);
-        name = g_strdup_printf("%s(%d)", basename, i);
-        child = g_file_get_child(dir, name);
-    }
-
+    GFile* child = desktop_names_get_free_child(dir, basename, basename, "");
     g_object_unref(dir);
     return child;
 }
@@ -300,16 +285,7 @@ GFile* _get_useable_file(const char* basename)
 GFile* _get_useable_file_templates(const char* basename,const char* name_add_before)
 {
     GFile* dir = g_file_new_for_path(DESKTOP_DIR());
-
-    char* name = g_strdup(basename);
-    GFile* child = g_file_get_child(dir, name);
-    for (int i=0; g_file_query_exists(child, NULL); i++) {
-        g_object_unref(child);
-        g_free(name);
-        name = g_strdup_printf("%s(%d)%s",name_add_before, i,basename);
-        child = g_file_get_child(dir, name);
-    }
-
+    GFile* child = desktop_names_get_free_child(dir, basename, name_add_before, basename);
     g_object_unref(dir);
     return child;
 }
@@ -322,6 +298,8 @@ GFile* desktop_new_file(const char* name_add_before)
         g_file_create(file, G_FILE_CREATE_NONE, NULL, NULL);
     if (stream)
         g_object_unref(stream);
+    else
+        desktop_names_unreserve(file);
     return file;
 }
 
@@ -331,8 +309,11 @@ GFile* desktop_new_directory(const char* name_add_before)
     GFile* dir = _get_useable_file_templates(_("New directory"),name_add_before);
     GError* error = NULL;
     g_file_make_directory(dir, NULL, &error);
-    if (error)
+    if (error) {
       fprintf(stderr,"%s %d: %s", __FUNCTION__, __LINE__, error->message);
+      g_error_free(error);
+      desktop_names_unreserve(dir);
+    }
     //TODO: detect create status..
     return dir;
 }
@@ -380,8 +361,27 @@ int get_workarea_height(int primary_height)
     return area_heigth;
 }
 
-PRIVATE gboolean update_workarea_size()
+PRIVATE gboolean update_workarea_size();
+static guint _workarea_update_id = 0;
+
+
+PRIVATE gboolean _retry_update_workarea_size(gpointer user_data G_GNUC_UNUSED)
 {
+    _workarea_update_id = 0;
+    update_workarea_size();
+    return G_SOURCE_REMOVE;
+}
+
+
+/*
+ * Post workarea_changed, unless @force is FALSE and the workarea is the one
+ * posted last time.
+ */
+PRIVATE void _post_workarea_size(gboolean force)
+{
+    static int last_width = -1;
+    static int last_height = -1;
+
     update_primary_info(&rect_primary);
 
   //rect_primary.x = 100;
@@ -390,10 +390,15 @@ PRIVATE gboolean update_workarea_size()
   //rect_primary.height = 480;
 
     if (rect_primary.width == 0 || rect_primary.height == 0) {
-        g_timeout_add(200, (GSourceFunc)update_workarea_size, NULL);
-        return G_SOURCE_REMOVE;
+        if (_workarea_update_id == 0)
+            _workarea_update_id = g_timeout_add(200, _retry_update_workarea_size, NULL);
+        return;
     }
     int height = get_workarea_height(rect_primary.height);
+    if (!force && rect_primary.width == last_width && height == last_height)
+        return;
+    last_width = rect_primary.width;
+    last_height = height;
     //JSObjectRef workarea_info = json_create();
     //json_append_number(workarea_info, "x", 0);
     //json_append_number(workarea_info, "y", 0);
@@ -409,6 +414,11 @@ PRIVATE gboolean update_workarea_size()
     json_object_object_add(workarea_info, "height", json_object_new_int(height));
     fprintf(stderr,"[%s]:workarea_changed signal:%d*%d(%d,%d)",__func__,rect_primary.width,height,rect_primary.x,rect_primary.y);
     js_post_message("workarea_changed", workarea_info);
+}
+
+PRIVATE gboolean update_workarea_size()
+{
+    _post_workarea_size(TRUE);
     return G_SOURCE_REMOVE;
 }
 
@@ -520,20 +530,7 @@ char* desktop_get_data_dir()
 JS_EXPORT_API
 gboolean desktop_file_exist_in_desktop(char* name)
 {
-    GDir* dir = g_dir_open(DESKTOP_DIR(), 0, NULL);
-    gboolean result = False;
-    const char* file_name = NULL;
-    while (NULL != (file_name = g_dir_read_name(dir))) {
-        if(desktop_file_filter(file_name))
-            continue;
-        if(0 == g_strcmp0(name,file_name))
-        {
-            result = True;
-        }
-
-    }
-    g_dir_close(dir);
-    return result;
+    return !desktop_file_filter(name) && desktop_names_contains(name);
 }
 
 
@@ -590,18 +587,15 @@ void desktop_set_position_input(double x , double y)
 JS_EXPORT_API
 gboolean desktop_check_version_equal_set(const char* version_set)
 {
-    GKeyFile* desktop_config = NULL;
     gboolean result = FALSE;
-    if (desktop_config == NULL)
-        desktop_config = load_app_config(DESKTOP_CONFIG);
+    GKeyFile* desktop_config = config_store_get(DESKTOP_CONFIG);
 
     GError* err = NULL;
     gchar* version = g_key_file_get_string(desktop_config, "main", "version", &err);
     if (err != NULL) {
         fprintf(stderr,"[%s] read version failed from config file: %s", __func__, err->message);
         g_error_free(err);
-        g_key_file_set_string(desktop_config, "main", "version", DESKTOP_VERSION);
-        save_app_config(desktop_config, DESKTOP_CONFIG);
+        config_store_set_string(DESKTOP_CONFIG, "main", "version", DESKTOP_VERSION);
         g_message("desktop version : %s ",version);
     }
     else{
@@ -609,16 +603,13 @@ gboolean desktop_check_version_equal_set(const char* version_set)
             result = TRUE;
         else{
             result = FALSE;
-            g_key_file_set_string(desktop_config, "main", "version", version_set);
-            save_app_config(desktop_config, DESKTOP_CONFIG);
+            config_store_set_string(DESKTOP_CONFIG, "main", "version", version_set);
             g_message("desktop version from %s update to %s",version,version_set);
         }
     }
 
     if (version != NULL)
         g_free(version);
-    g_key_file_unref(desktop_config);
-    desktop_config = NULL;
 
     return result;
 }
@@ -723,58 +714,56 @@ int main(int argc, char* argv[])
   #endif
 
 
-PRIVATE GdkFilterReturn watch_root_window(GdkXEvent *gxevent, GdkEvent* event G_GNUC_UNUSED, gpointer user_data)
-{
-    XPropertyEvent *xevt = (XPropertyEvent*)gxevent;
-
-    if (xevt->type == PropertyNotify) {
-    //TODO: cache the atom of "_NET_WORKAREA" and "_NET_ACTIVE_WINDOW"
-    //
-    if (xevt->atom == gdk_x11_get_xatom_by_name("_NET_WORKAREA")) {
-        g_message("GET _NET_WORKAREA change on rootwindow");
-        dock_gsettings = user_data;
-        //TODO:check if the change caused by dde-dock
-        //if FALSE then update_workarea_size
-        //or dont update_workarea_size in dock_display_mode_changed and dock_hide_mode_changed function
-        update_workarea_size ();
-        return GDK_FILTER_CONTINUE;
-    } else if (xevt->atom == gdk_x11_get_xatom_by_name("_NET_ACTIVE_WINDOW")) {
-        Window active_window=0;
-        gboolean state = False;
-        if ((state = get_atom_value_by_name(xevt->display, xevt->window, "_NET_ACTIVE_WINDOW", &active_window, get_atom_value_for_index,0))) {
-        static gboolean has_focus= False;
-
-        for (size_t i=0; i < sizeof(__DESKTOP_XID)/sizeof(Window); i++) {
-            if (__DESKTOP_XID[i] == active_window) {
-            has_focus = True;
-            desktop_focus_changed(has_focus);
-            return GDK_FILTER_CONTINUE;
-            }
-        }
+PRIVATE gboolean _workarea_changed_idle(gpointer user_data G_GNUC_UNUSED)
+{
+    _workarea_update_id = 0;
+    _post_workarea_size(FALSE);
+    return G_SOURCE_REMOVE;
+}
+
+
+PRIVATE void _on_workarea_changed(XPropertyEvent* xevt G_GNUC_UNUSED, gpointer user_data)
+{
+    g_debug("GET _NET_WORKAREA change on rootwindow");
+    dock_gsettings = user_data;
+    //TODO:check if the change caused by dde-dock
+    //if FALSE then update_workarea_size
+    //or dont update_workarea_size in dock_display_mode_changed and dock_hide_mode_changed function
+
+    // a burst of changes is handled once, and only posted when the
+    // workarea really changed.
+    if (_workarea_update_id == 0)
+        _workarea_update_id = g_idle_add(_workarea_changed_idle, NULL);
+}
 
-        has_focus = False;
-        desktop_focus_changed(has_focus);
+
+PRIVATE void _on_active_window_changed(XPropertyEvent* xevt, gpointer user_data G_GNUC_UNUSED)
+{
+    Window active_window = 0;
+    if (!get_atom_value_by_atom(xevt->display, xevt->window, get_atom(ATOM_NET_ACTIVE_WINDOW),
+                                &active_window, get_atom_value_for_index, 0))
+        return;
+
+    gboolean has_focus = FALSE;
+    for (size_t i=0; i < sizeof(__DESKTOP_XID)/sizeof(Window); i++) {
+        if (__DESKTOP_XID[i] == active_window) {
+            has_focus = TRUE;
+            break;
         }
     }
-    }
-    return GDK_FILTER_CONTINUE;
+    desktop_focus_changed(has_focus);
 }
 
-void setup_root_window_watcher(GtkWidget* widget, GSettings* dock_gsettings)
+void setup_root_window_watcher(GtkWidget* widget G_GNUC_UNUSED, GSettings* dock_gsettings)
 {
-
-    GdkScreen *gscreen = gtk_widget_get_screen(widget);
-    GdkWindow *groot = gdk_screen_get_root_window(gscreen);
-    gdk_window_set_events(groot, gdk_window_get_events(groot) | GDK_PROPERTY_CHANGE_MASK);
-    //TODO: remove this filter when unrealize
-    gdk_window_add_filter(groot, watch_root_window, dock_gsettings);
+    watch_root_property(ATOM_NET_WORKAREA, _on_workarea_changed, dock_gsettings);
+    watch_root_property(ATOM_NET_ACTIVE_WINDOW, _on_active_window_changed, NULL);
 }
 
-void unwatch_workarea_changes(GtkWidget* widget)
+void unwatch_workarea_changes(GtkWidget* widget G_GNUC_UNUSED)
 {
-    GdkScreen *gscreen = gtk_widget_get_screen(widget);
-    GdkWindow *groot = gdk_screen_get_root_window(gscreen);
-    gdk_window_remove_filter(groot, watch_root_window, NULL);
+    unwatch_root_property(ATOM_NET_WORKAREA, _on_workarea_changed, dock_gsettings);
+    unwatch_root_property(ATOM_NET_ACTIVE_WINDOW, _on_active_window_changed, NULL);
 }
 
 static gboolean __init__ = FALSE;
@@ -0,0 +1,278 @@
+/**
+ * Copyright (c) 2011 ~ 2014 Deepin, Inc.
+ *               2011 ~ 2014 snyh
+ *
+ * Author:      snyh <snyh@snyh.org>
+ * Maintainer:  snyh <snyh@snyh.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ **/
+#define _GNU_SOURCE
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+
+#include <glib.h>
+#include <gio/gio.h>
+#include <gio/gdesktopappinfo.h>
+
+#include "common/utils.h"
+#include "common/xdg_misc.h"
+#include "dentry/entry.h"
+#include "dentry/entry_cache.h"
+#include "dentry/thumbnails.h"
+#include "inotify_item.h"
+#include "desktop_snapshot.h"
+
+#include "json-c/json.h"
+
+/* the same values returned by dentry_get_type */
+#define ENTRY_TYPE_UNKNOWN (-1)
+#define ENTRY_TYPE_APP 0
+#define ENTRY_TYPE_FILE 1
+#define ENTRY_TYPE_DIR 2
+#define ENTRY_TYPE_RICH_DIR 3
+#define ENTRY_TYPE_INVALID_LINK 4
+
+
+typedef struct _Credential {
+    uid_t uid;
+    gid_t gid;
+    int ngroups;
+    gid_t* groups;
+} Credential;
+
+
+PRIVATE
+void _init_credential(Credential* cred)
+{
+    cred->uid = geteuid();
+    cred->gid = getegid();
+    cred->ngroups = getgroups(0, NULL);
+    cred->groups = NULL;
+    if (cred->ngroups > 0) {
+        cred->groups = g_new(gid_t, cred->ngroups);
+        cred->ngroups = getgroups(cred->ngroups, cred->groups);
+    }
+}
+
+
+PRIVATE
+gboolean _in_group(Credential const* cred, gid_t gid)
+{
+    if (gid == cred->gid)
+        return TRUE;
+
+    for (int i = 0; i < cred->ngroups; ++i)
+        if (cred->groups[i] == gid)
+            return TRUE;
+
+    return FALSE;
+}
+
+
+/*
+ * Answer access(2) from the stat result instead of issuing another syscall.
+ * ACLs are ignored, which is what gvfs does for the desktop listing anyway.
+ */
+PRIVATE
+gboolean _can_access(Credential const* cred, struct stat const* st, mode_t user_bit)
+{
+    if (cred->uid == 0)
+        return TRUE;
+
+    if (st->st_uid == cred->uid)
+        return (st->st_mode & user_bit) != 0;
+
+    if (_in_group(cred, st->st_gid))
+        return (st->st_mode & (user_bit >> 3)) != 0;
+
+    return (st->st_mode & (user_bit >> 6)) != 0;
+}
+
+
+PRIVATE
+int _get_entry_type(char const* name, mode_t mode, gboolean is_app)
+{
+    if (is_app)
+        return ENTRY_TYPE_APP;
+
+    if (S_ISREG(mode))
+        return ENTRY_TYPE_FILE;
+
+    if (S_ISDIR(mode))
+        return g_str_has_prefix(name, DEEPIN_RICH_DIR) ? ENTRY_TYPE_RICH_DIR : ENTRY_TYPE_DIR;
+
+    return ENTRY_TYPE_UNKNOWN;
+}
+
+
+PRIVATE
+char* _get_icon_key(Entry* entry, char const* name, mode_t mode)
+{
+    if (G_IS_APP_INFO(entry)) {
+        GIcon* icon = g_app_info_get_icon(G_APP_INFO(entry));
+        return icon != NULL ? g_icon_to_string(icon) : NULL;
+    }
+
+    if (S_ISDIR(mode))
+        return g_strdup("inode/directory");
+
+    // guess by name only, dentry_get_icon is still there for exact result.
+    return g_content_type_guess(name, NULL, 0, NULL);
+}
+
+
+/*
+ * Stat @name into @st following symlinks. d_type tells whether it is a
+ * symlink, so only DT_UNKNOWN entries and dangling links need an lstat too.
+ */
+PRIVATE
+gboolean _stat_entry(int dir_fd, char const* name, unsigned char d_type,
+                     struct stat* st, gboolean* is_symlink, gboolean* is_dangling)
+{
+    *is_dangling = FALSE;
+
+    if (d_type == DT_UNKNOWN) {
+        if (fstatat(dir_fd, name, st, AT_SYMLINK_NOFOLLOW) != 0)
+            return FALSE;
+        *is_symlink = S_ISLNK(st->st_mode);
+        if (!*is_symlink)
+            return TRUE;
+    } else {
+        *is_symlink = d_type == DT_LNK;
+    }
+
+    if (fstatat(dir_fd, name, st, 0) == 0)
+        return TRUE;
+
+    if (!*is_symlink)
+        return FALSE;
+
+    // a dangling link, describe the link itself.
+    *is_dangling = TRUE;
+    return fstatat(dir_fd, name, st, AT_SYMLINK_NOFOLLOW) == 0;
+}
+
+
+PRIVATE
+json_object* _build_record(int dir_fd, char const* dir_path, char const* name,
+                           unsigned char d_type, Credential const* cred, gboolean can_delete)
+{
+    struct stat st;
+    gboolean is_symlink = FALSE;
+    gboolean is_dangling = FALSE;
+    if (!_stat_entry(dir_fd, name, d_type, &st, &is_symlink, &is_dangling))
+        return NULL;
+
+    int type = is_dangling ? ENTRY_TYPE_INVALID_LINK : ENTRY_TYPE_UNKNOWN;
+
+    char* path = g_build_filename(dir_path, name, NULL);
+    Entry* entry = dentry_create_by_path(path);
+
+    if (type != ENTRY_TYPE_INVALID_LINK) {
+        type = _get_entry_type(name, st.st_mode, G_IS_APP_INFO(entry));
+        if (is_symlink && type == ENTRY_TYPE_UNKNOWN)
+            type = ENTRY_TYPE_INVALID_LINK;
+    }
+
+    json_object* flags = json_object_new_object();
+    // access of the target, the mode of a symlink itself is always 0777.
+    json_object_object_add(flags, "read_only",
+                           json_object_new_double(!_can_access(cred, &st, S_IWUSR)));
+    json_object_object_add(flags, "symbolic_link", json_object_new_double(is_symlink));
+    json_object_object_add(flags, "unreadable",
+                           json_object_new_double(!_can_access(cred, &st, S_IRUSR)));
+
+    char* icon_key = _get_icon_key(entry, name, st.st_mode);
+
+    gboolean can_thumbnail = FALSE;
+    if (type == ENTRY_TYPE_FILE && icon_key != NULL) {
+        char* uri = g_filename_to_uri(path, NULL, NULL);
+        char* mime_type = g_content_type_get_mime_type(icon_key);
+        can_thumbnail = uri_can_thumbnail(uri, mime_type, st.st_mtime);
+        g_free(mime_type);
+        g_free(uri);
+    }
+
+    json_object* record = json_object_new_object();
+    json_object_object_add(record, "entry", json_object_new_int64((int64_t)entry_cache_export(entry)));
+    json_object_object_add(record, "name", json_object_new_string(name));
+    json_object_object_add(record, "type", json_object_new_int(type));
+    json_object_object_add(record, "mtime", json_object_new_int64(st.st_ctime));
+    json_object_object_add(record, "size", json_object_new_int64(st.st_size));
+    json_object_object_add(record, "flags", flags);
+    json_object_object_add(record, "should_move", json_object_new_boolean(can_delete));
+    json_object_object_add(record, "can_thumbnail", json_object_new_boolean(can_thumbnail));
+    json_object_object_add(record, "icon", json_object_new_string(icon_key ? icon_key : ""));
+
+    g_object_unref(entry);
+    g_free(icon_key);
+    g_free(path);
+
+    return record;
+}
+
+
+/*
+ * List the desktop with one readdir pass and one fstatat per entry (more only
+ * for dangling links or when the fs doesn't fill d_type), returning everything the desktop needs to lay out the items:
+ *
+ *   [{ entry, name, type, mtime, size, flags, should_move, can_thumbnail, icon }]
+ *
+ * "entry" is the same handle desktop_get_desktop_entries returns, "type"
+ * matches dentry_get_type, and "icon" is the icon key (theme icon name for
+ * applications, content type guessed by name for others) used to cache the
+ * icon lookups on the JS side.
+ */
+JS_EXPORT_API
+json_object* desktop_get_desktop_snapshot()
+{
+    json_object* array = json_object_new_array();
+
+    char const* dir_path = DESKTOP_DIR();
+    DIR* dir = opendir(dir_path);
+    if (dir == NULL) {
+        g_warning("[%s] open %s failed", __func__, dir_path);
+        return array;
+    }
+
+    Credential cred;
+    _init_credential(&cred);
+
+    int dir_fd = dirfd(dir);
+    // all the entries share the same parent, so access::can-delete is the
+    // same for them.
+    gboolean can_delete = faccessat(dir_fd, ".", W_OK | X_OK, 0) == 0;
+
+    struct dirent* dirent = NULL;
+    while ((dirent = readdir(dir)) != NULL) {
+        if (desktop_file_filter(dirent->d_name))
+            continue;
+
+        json_object* record = _build_record(dir_fd, dir_path, dirent->d_name, dirent->d_type,
+                                             &cred, can_delete);
+        if (record != NULL)
+            json_object_array_add(array, record);
+    }
+
+    closedir(dir);
+    g_free(cred.groups);
+
+    return array;
+}
+
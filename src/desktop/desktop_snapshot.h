@@ -0,0 +1,8 @@
+#ifndef __DESKTOP_SNAPSHOT_H__
+#define __DESKTOP_SNAPSHOT_H__
+
+#include "json-c/json.h"
+
+json_object* desktop_get_desktop_snapshot();
+
+#endif
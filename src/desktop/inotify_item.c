@@ -28,7 +28,10 @@
 #include "common/utils.h"
 #include "common/xdg_misc.h"
 #include "dentry/entry.h"
-#include "json-c/json.h"
+#include "dentry/entry_cache.h"
+#include "dentry/desktop_names.h"
+#include "dentry/trash_watcher.h"
+#include "dcore/signal.h"
 
 extern void desktop_item_update();
 PRIVATE gboolean _inotify_poll();
@@ -38,23 +41,8 @@ void handle_delete(GFile* f);
 
 static GHashTable* _monitor_table = NULL;
 static GFile* _desktop_file = NULL;
-static GFile* _trash_can = NULL;
 static int _inotify_fd = -1;
 
-extern void js_post_message(const char* name, json_object* json);
-extern void js_post_signal(const char* signal);
-
-void trash_changed()
-{
-    GFileInfo* info = g_file_query_info(_trash_can, G_FILE_ATTRIBUTE_TRASH_ITEM_COUNT, G_FILE_QUERY_INFO_NONE, NULL, NULL);
-    int count = g_file_info_get_attribute_uint32(info, G_FILE_ATTRIBUTE_TRASH_ITEM_COUNT);
-    g_object_unref(info);
-    //JSObjectRef value = json_create();
-    //json_append_number(value, "value", count);
-    json_object* value = json_object_new_object();
-    json_object_object_add(value, "value", json_object_new_int(count));
-    js_post_message("trash_count_changed", value);
-}
 
 PRIVATE
 void _add_monitor_directory(GFile* f)
@@ -86,11 +74,10 @@ void install_monitor()
         g_timeout_add(50, (GSourceFunc)_inotify_poll, NULL);
 
         _desktop_file = g_file_new_for_commandline_arg(DESKTOP_DIR());
-        _trash_can = g_file_new_for_uri("trash:///");
-        GFileMonitor* m = g_file_monitor(_trash_can, G_FILE_MONITOR_NONE, NULL, NULL);
-        g_signal_connect(m, "changed", G_CALLBACK(trash_changed), NULL);
+        trash_watcher_start();
 
         _add_monitor_directory(_desktop_file);
+        desktop_names_set_watched(TRUE);
 
         GDir *dir =  g_dir_open(DESKTOP_DIR(), 0, NULL);
 
@@ -111,29 +98,29 @@ void handle_rename(GFile* old_f, GFile* new_f)
     _add_monitor_directory(new_f);
     _remove_monitor_directory(old_f);
 
+    Entry* old_entry = entry_cache_take(old_f);
+
     char* path = g_file_get_path(new_f);
     Entry* entry = dentry_create_by_path(path);
     g_free(path);
 
-    //JSObjectRef json = json_create();
-    //json_append_nobject(json, "old", old_f, g_object_ref, g_object_unref);
-    //json_append_nobject(json, "new", entry, g_object_ref, g_object_unref);
-    json_object* json = json_object_new_object();
-    json_object_object_add(json, "old", json_object_new_int64((int64_t)old_f));
-    json_object_object_add(json, "new", json_object_new_int64((int64_t)entry));
-    js_post_message("item_rename", json);
+    js_signal_begin("item_rename");
+    js_signal_add_int("old", (int64_t)entry_cache_export(old_entry));
+    js_signal_add_int("new", (int64_t)entry_cache_export(entry));
+    js_signal_end();
 
-    //g_object_unref(entry);
+    g_object_unref(old_entry);
+    g_object_unref(entry);
 }
 
 void handle_delete(GFile* f)
 {
     _remove_monitor_directory(f);
-    //JSObjectRef json = json_create();
-    //json_append_nobject(json, "entry", f, g_object_ref, g_object_unref);
-    json_object* json = json_object_new_object();
-    json_object_object_add(json, "entry", json_object_new_int64((int64_t)f));
-    js_post_message("item_delete", json);
+    Entry* entry = entry_cache_take(f);
+    js_signal_begin("item_delete");
+    js_signal_add_int("entry", (int64_t)entry_cache_export(entry));
+    js_signal_end();
+    g_object_unref(entry);
 }
 
 void handle_update(GFile* f)
@@ -144,14 +131,12 @@ void handle_update(GFile* f)
         Entry* entry = dentry_create_by_path(path);
         g_free(path);
 
-        //JSObjectRef json = json_create();
-        //json_append_nobject(json, "entry", entry, g_object_ref, g_object_unref);
-        json_object* json = json_object_new_object();
-        json_object_object_add(json, "entry", json_object_new_int64((int64_t)entry));
-        js_post_message("item_update", json);
+        js_signal_begin("item_update");
+        js_signal_add_int("entry", (int64_t)entry_cache_export(entry));
+        js_signal_end();
         desktop_item_update();
 
-        //g_object_unref(entry);
+        g_object_unref(entry);
     }
 }
 
@@ -185,6 +170,20 @@ void _remove_monitor_directory(GFile* f)
 }
 
 
+PRIVATE
+void _update_desktop_names(struct inotify_event* event)
+{
+    GFile* p = g_hash_table_lookup(_monitor_table, GINT_TO_POINTER(event->wd));
+    if (p == NULL || !g_file_equal(p, _desktop_file))
+        return;
+
+    if (event->mask & (IN_CREATE | IN_MOVED_TO))
+        desktop_names_add(event->name);
+    else if (event->mask & (IN_DELETE | IN_MOVED_FROM))
+        desktop_names_remove(event->name);
+}
+
+
 // test important
 PRIVATE
 gboolean _inotify_poll()
@@ -202,6 +201,13 @@ gboolean _inotify_poll()
         for (int i=0; i<length; ) {
             struct inotify_event *event = (struct inotify_event *) &buffer[i];
             i += EVENT_SIZE+event->len;
+            if (event->mask & IN_Q_OVERFLOW) {
+                desktop_names_invalidate();
+                continue;
+            }
+            // the name index keeps the hidden files too.
+            if (event->len)
+                _update_desktop_names(event);
             if(desktop_file_filter(event->name))
                 continue;
             if (event->len) {
@@ -28,6 +28,7 @@
 #include "common/X_misc.h"
 #include "common/xdg_misc.h"
 #include "common/utils.h"
+#include "common/config_store.h"
 #include "common/i18n.h"
 #include "dock_config.h"
 #include "region.h"
@@ -100,7 +101,7 @@ JS_EXPORT_API
 double dock_get_active_window()
 {
     Window aw = 0;
-    Atom ATOM_ACTIVE_WINDOW = gdk_x11_get_xatom_by_name("_NET_ACTIVE_WINDOW");
+    Atom ATOM_ACTIVE_WINDOW = get_atom(ATOM_NET_ACTIVE_WINDOW);
     Display* _dsp = GDK_DISPLAY_XDISPLAY(gdk_display_get_default());
     get_atom_value_by_atom(_dsp, GDK_ROOT_WINDOW(), ATOM_ACTIVE_WINDOW, &aw, get_atom_value_for_index, 0);
     return aw;
@@ -246,48 +247,46 @@ void check_compiz_validity()
 
 void check_version()
 {
-    GKeyFile* dock_config = load_app_config(DOCK_CONFIG);
+    GKeyFile* dock_config = config_store_get(DOCK_CONFIG);
 
     GError* err = NULL;
     gchar* version = g_key_file_get_string(dock_config, "main", "version", &err);
     if (err != NULL) {
         g_warning("[%s] read version failed from config file: %s", __func__, err->message);
         g_error_free(err);
-        g_key_file_set_string(dock_config, "main", "version", DOCK_VERSION);
-        save_app_config(dock_config, DOCK_CONFIG);
+        config_store_set_string(DOCK_CONFIG, "main", "version", DOCK_VERSION);
     }
 
     if (version != NULL && g_strcmp0(DOCK_VERSION, version) != 0) {
-        g_key_file_set_string(dock_config, "main", "version", DOCK_VERSION);
-        save_app_config(dock_config, DOCK_CONFIG);
+        config_store_set_string(DOCK_CONFIG, "main", "version", DOCK_VERSION);
 
         int noused G_GNUC_UNUSED;
         noused = system("sed -i 's/DockedItems/"DOCKED_ITEM_GROUP_NAME"/g' $HOME/.config/"APPS_INI);
-        GKeyFile* f = load_app_config(APPS_INI);
+        GKeyFile* f = config_store_get(APPS_INI);
         gsize len = 0;
         char** list = g_key_file_get_groups(f, &len);
         for (guint i = 1; i < len; ++i) {
             /* g_key_file_set_string(f, list[i], "Type", DOCKED_ITEM_APP_TYPE); */
             if (g_strcmp0(list[i], "wps") == 0) {
-                g_key_file_set_string(f, list[i], "Name", "Kingsoft Write");
-                g_key_file_set_string(f, list[i], "CmdLine", "/usr/bin/wps %%f");
-                g_key_file_set_string(f, list[i], "Icon", "wps-office-wpsmain");
-                g_key_file_set_string(f, list[i], "Path", "/usr/share/aplications/wps-office-wps.desktop");
-                g_key_file_set_string(f, list[i], "Terminal", "false");
+                config_store_set_string(APPS_INI, list[i], "Name", "Kingsoft Write");
+                config_store_set_string(APPS_INI, list[i], "CmdLine", "/usr/bin/wps %%f");
+                config_store_set_string(APPS_INI, list[i], "Icon", "wps-office-wpsmain");
+                config_store_set_string(APPS_INI, list[i], "Path", "/usr/share/aplications/wps-office-wps.desktop");
+                config_store_set_string(APPS_INI, list[i], "Terminal", "false");
             }
             if (g_strcmp0(list[i], "wpp") == 0) {
-                g_key_file_set_string(f, list[i], "Name", "Kingsoft Presentation");
-                g_key_file_set_string(f, list[i], "CmdLine", "/usr/bin/wpp %%f");
-                g_key_file_set_string(f, list[i], "Icon", "wps-office-wppmain");
-                g_key_file_set_string(f, list[i], "Path", "/usr/share/aplications/wps-office-wpp.desktop");
-                g_key_file_set_string(f, list[i], "Terminal", "false");
+                config_store_set_string(APPS_INI, list[i], "Name", "Kingsoft Presentation");
+                config_store_set_string(APPS_INI, list[i], "CmdLine", "/usr/bin/wpp %%f");
+                config_store_set_string(APPS_INI, list[i], "Icon", "wps-office-wppmain");
+                config_store_set_string(APPS_INI, list[i], "Path", "/usr/share/aplications/wps-office-wpp.desktop");
+                config_store_set_string(APPS_INI, list[i], "Terminal", "false");
             }
             if (g_strcmp0(list[i], "et") == 0) {
-                g_key_file_set_string(f, list[i], "Name", "Kingsoft Spreadsheet");
-                g_key_file_set_string(f, list[i], "CmdLine", "/usr/bin/et %%f");
-                g_key_file_set_string(f, list[i], "Icon", "wps-office-etmain");
-                g_key_file_set_string(f, list[i], "Path", "/usr/share/aplications/wps-office-et.desktop");
-                g_key_file_set_string(f, list[i], "Terminal", "false");
+                config_store_set_string(APPS_INI, list[i], "Name", "Kingsoft Spreadsheet");
+                config_store_set_string(APPS_INI, list[i], "CmdLine", "/usr/bin/et %%f");
+                config_store_set_string(APPS_INI, list[i], "Icon", "wps-office-etmain");
+                config_store_set_string(APPS_INI, list[i], "Path", "/usr/share/aplications/wps-office-et.desktop");
+                config_store_set_string(APPS_INI, list[i], "Terminal", "false");
             }
         }
         g_strfreev(list);
@@ -313,19 +312,17 @@ void check_version()
             }
         }
         if (list != NULL) {
-            g_key_file_set_string_list(f, DOCKED_ITEM_GROUP_NAME, DOCKED_ITEM_KEY_NAME, (const char* const*)list, len);
+            config_store_set_string_list(APPS_INI, DOCKED_ITEM_GROUP_NAME, DOCKED_ITEM_KEY_NAME, (const char* const*)list, len);
             g_strfreev(list);
         }
-        save_app_config(f, APPS_INI);
+        // the group renames below edit the file itself.
+        config_store_flush();
         noused = system("sed -i 's/\\[wps\\]/\\[wps-office-wps\\]/g' $HOME/.config/"APPS_INI);
         noused = system("sed -i 's/\\[wpp\\]/\\[wps-office-wpp\\]/g' $HOME/.config/"APPS_INI);
         noused = system("sed -i 's/\\[et\\]/\\[wps-office-et\\]/g' $HOME/.config/"APPS_INI);
-        g_key_file_unref(f);
     }
 
     g_free(version);
-
-    g_key_file_unref(dock_config);
 }
 
 
@@ -610,7 +607,7 @@ int main(int argc, char* argv[])
     /*gdk_window_set_debug_updates(TRUE);*/
 
     setup_dock_dbus_service();
-    GFileMonitor* m G_GNUC_UNUSED = monitor_trash();
+    monitor_trash();
 
     gtk_widget_show_all(container);
 
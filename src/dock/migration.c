@@ -16,8 +16,8 @@
 int _is_maximized_window(Window win)
 {
     gulong items;
-    Atom ATOM_WINDOW_NET_STATE = gdk_x11_get_xatom_by_name("_NET_WM_STATE");
-    Atom ATOM_WINDOW_MAXIMIZED_VERT = gdk_x11_get_xatom_by_name("_NET_WM_STATE_MAXIMIZED_VERT");
+    Atom ATOM_WINDOW_NET_STATE = get_atom(ATOM_NET_WM_STATE);
+    Atom ATOM_WINDOW_MAXIMIZED_VERT = get_atom(ATOM_NET_WM_STATE_MAXIMIZED_VERT);
     Display* _dsp = GDK_DISPLAY_XDISPLAY(gdk_display_get_default());
     long* data = get_window_property(_dsp, win, ATOM_WINDOW_NET_STATE, &items);
 
@@ -34,7 +34,7 @@ int _is_maximized_window(Window win)
 }
 gboolean dock_has_maximize_client()
 {
-    Atom ATOM_CLIENT_LIST = gdk_x11_get_xatom_by_name("_NET_CLIENT_LIST");
+    Atom ATOM_CLIENT_LIST = get_atom(ATOM_NET_CLIENT_LIST);
     Display* _dsp = GDK_DISPLAY_XDISPLAY(gdk_display_get_default());
     gulong items;
     Window root = GDK_ROOT_WINDOW();
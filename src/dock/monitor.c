@@ -19,47 +19,11 @@
  * along with this program; if not, see <http://www.gnu.org/licenses/>.
  **/
 
-#include <stdlib.h>
+#include "dentry/trash_watcher.h"
 
-#include <gio/gio.h>
 
-//#include "jsextension.h"
-#include "common/utils.h"
-
-static GFile* trash_can = NULL;
-static GFileMonitor* m = NULL;
-
-
-void destroy_monitor()
-{
-    g_object_unref(trash_can);
-    g_object_unref(m);
-}
-
-
-void trash_changed(GFileMonitor* monitor G_GNUC_UNUSED,
-                   GFile* file G_GNUC_UNUSED,
-                   GFile* other_file G_GNUC_UNUSED,
-                   GFileMonitorEvent event_type G_GNUC_UNUSED,
-                   gpointer data G_GNUC_UNUSED)
-{
-  /*
-    GFileInfo* info = g_file_query_info(trash_can, G_FILE_ATTRIBUTE_TRASH_ITEM_COUNT, G_FILE_QUERY_INFO_NONE, NULL, NULL);
-    int count = g_file_info_get_attribute_uint32(info, G_FILE_ATTRIBUTE_TRASH_ITEM_COUNT);
-    g_object_unref(info);
-    JSObjectRef value = json_create();
-    json_append_number(value, "value", count);
-    js_post_message("trash_count_changed", value);
-    */
-}
-
-
-GFileMonitor* monitor_trash()
+// the trash count is shared with the desktop code through the watcher.
+void monitor_trash()
 {
-    atexit(destroy_monitor);
-    trash_can = g_file_new_for_uri("trash:///");
-    m = g_file_monitor_directory(trash_can, G_FILE_MONITOR_SEND_MOVED, NULL, NULL);
-    g_signal_connect(m, "changed", G_CALLBACK(trash_changed), NULL);
-    return m;
+    trash_watcher_start();
 }
-
@@ -21,7 +21,7 @@
 #ifndef MONITOR_H_96QT8PFY
 #define MONITOR_H_96QT8PFY
 
-GFileMonitor* monitor_trash();
+void monitor_trash();
 
 #endif /* end of include guard: MONITOR_H_96QT8PFY */
 
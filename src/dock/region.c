@@ -26,6 +26,7 @@
 #include "dock_hide.h"
 
 #include "common/config.h"
+#include "dcore/perf_stats.h"
 
 cairo_region_t* _region = NULL;
 GdkWindow* _win = NULL;
@@ -46,6 +47,37 @@ gboolean dock_set_is_hovered(gboolean state)
 }
 
 
+/*
+ * _region is the input shape the dock wants, the shape really applied to the
+ * window is kept in _applied so that a flush can skip requests which end up
+ * where they started and repaint only what changed.
+ */
+static struct {
+    cairo_region_t* region; // NULL when nothing has been applied yet
+    gboolean all; // the whole window, from dock_require_all_region
+} _applied = { NULL, FALSE };
+static gboolean _pending_all = FALSE;
+static struct {
+    guint requests; // dock_require_region/dock_release_region calls
+    guint skipped_requests; // the ones which didn't change the region
+    guint shape_requests; // input shapes sent to X
+    guint skipped_shapes; // flushes which ended at the applied shape
+} _stats = { 0, 0, 0, 0 };
+
+#define SHAPE_DELAY_MS 100
+
+
+PRIVATE
+void _reset_applied()
+{
+    if (_applied.region != NULL) {
+        cairo_region_destroy(_applied.region);
+        _applied.region = NULL;
+    }
+    _applied.all = FALSE;
+}
+
+
 void init_region(GdkWindow* win, double x, double y, double width, double height)
 {
     if (_win == NULL) {
@@ -55,6 +87,8 @@ void init_region(GdkWindow* win, double x, double y, double width, double height
         _base_rect.y = y;
         _base_rect.width = width;
         _base_rect.height = height;
+        _pending_all = FALSE;
+        _reset_applied();
         dock_require_region(0, 0, width, height);
     } else {
         _win = NULL;
@@ -64,9 +98,12 @@ void init_region(GdkWindow* win, double x, double y, double width, double height
 }
 
 
-static int _do_shape_timer_id = -1;
+static guint _do_shape_timer_id = 0;
+static gint64 _do_shape_deadline = 0;
+
+
 PRIVATE
-gboolean _help_do_window_region(cairo_region_t* region)
+void _apply_window_region(cairo_region_t* region)
 {
 #ifndef NDEBUG
     if (region != NULL) {
@@ -78,15 +115,52 @@ gboolean _help_do_window_region(cairo_region_t* region)
     }
 #endif
 
-    _do_shape_timer_id  = -1;
+    extern GdkWindow* DOCK_GDK_WINDOW();
+
+    if (region == NULL ? _applied.all : (_applied.region != NULL && cairo_region_equal(_applied.region, region))) {
+        _stats.skipped_shapes++;
+        return;
+    }
+
+    _stats.shape_requests++;
     gdk_window_input_shape_combine_region(_win, region, 0, 0);
 
 #ifdef DEBUG_REGION
     gdk_window_shape_combine_region(_win, region, 0, 0);
 #endif
 
-    extern GdkWindow* DOCK_GDK_WINDOW();
-    gdk_window_invalidate_rect(DOCK_GDK_WINDOW(), NULL, FALSE);
+    // only the rectangles which entered or left the shape need a repaint,
+    // switching from or to the whole window repaints everything as before.
+    if (region != NULL && _applied.region != NULL && !_applied.all) {
+        cairo_region_t* damage = cairo_region_copy(region);
+        cairo_region_xor(damage, _applied.region);
+        gdk_window_invalidate_region(DOCK_GDK_WINDOW(), damage, FALSE);
+        cairo_region_destroy(damage);
+    } else {
+        gdk_window_invalidate_rect(DOCK_GDK_WINDOW(), NULL, FALSE);
+    }
+
+    _reset_applied();
+    if (region == NULL)
+        _applied.all = TRUE;
+    else
+        _applied.region = cairo_region_copy(region);
+}
+
+
+PRIVATE
+gboolean _help_do_window_region(gpointer user_data G_GNUC_UNUSED)
+{
+    // requests arriving while the timer is armed only push the deadline, so
+    // the timer is re-armed once here instead of on every request.
+    gint64 remain = _do_shape_deadline - g_get_monotonic_time();
+    if (remain > 1000) {
+        _do_shape_timer_id = g_timeout_add(remain / 1000, _help_do_window_region, NULL);
+        return G_SOURCE_REMOVE;
+    }
+
+    _do_shape_timer_id  = 0;
+    _apply_window_region(_pending_all ? NULL : _region);
 
     return G_SOURCE_REMOVE;
 }
@@ -94,9 +168,10 @@ gboolean _help_do_window_region(cairo_region_t* region)
 PRIVATE
 void do_window_shape_combine_region(cairo_region_t* region)
 {
-    if (_do_shape_timer_id != -1)
-        g_source_remove(_do_shape_timer_id);
-    _do_shape_timer_id = g_timeout_add(100, (GSourceFunc)_help_do_window_region, region);
+    _pending_all = region == NULL;
+    _do_shape_deadline = g_get_monotonic_time() + SHAPE_DELAY_MS * 1000;
+    if (_do_shape_timer_id == 0)
+        _do_shape_timer_id = g_timeout_add(SHAPE_DELAY_MS, _help_do_window_region, NULL);
 }
 
 
@@ -190,6 +265,11 @@ void dock_require_region(double x, double y, double width, double height)
         return;
     }
     cairo_rectangle_int_t tmp = {(int)x + _base_rect.x, (int)y + _base_rect.y, (int)width, (int)height};
+    _stats.requests++;
+    if (!_pending_all && cairo_region_contains_rectangle(_region, &tmp) == CAIRO_REGION_OVERLAP_IN) {
+        _stats.skipped_requests++;
+        return;
+    }
     cairo_region_union_rectangle(_region, &tmp);
     do_window_shape_combine_region(_region);
 }
@@ -198,6 +278,11 @@ void dock_require_region(double x, double y, double width, double height)
 void dock_release_region(double x, double y, double width, double height)
 {
     cairo_rectangle_int_t tmp = {(int)x + _base_rect.x, (int)y + _base_rect.y, (int)width, (int)height};
+    _stats.requests++;
+    if (!_pending_all && cairo_region_contains_rectangle(_region, &tmp) == CAIRO_REGION_OVERLAP_OUT) {
+        _stats.skipped_requests++;
+        return;
+    }
     cairo_region_subtract_rectangle(_region, &tmp);
     do_window_shape_combine_region(_region);
 }
@@ -212,11 +297,11 @@ void dock_set_region_origin(double x, double y)
 
 gboolean dock_region_overlay(const cairo_rectangle_int_t* tmp)
 {
-    cairo_region_t* region = cairo_region_copy(_region);
-    cairo_region_intersect_rectangle(region, &_base_rect);
-    gboolean r = (cairo_region_contains_rectangle(region, tmp) != CAIRO_REGION_OVERLAP_OUT);
-    cairo_region_destroy(region);
-    return r;
+    // (_region & _base_rect) overlaps tmp iff _region overlaps (tmp & _base_rect)
+    GdkRectangle rect;
+    if (!gdk_rectangle_intersect(tmp, &_base_rect, &rect))
+        return FALSE;
+    return cairo_region_contains_rectangle(_region, &rect) != CAIRO_REGION_OVERLAP_OUT;
 }
 
 
@@ -229,6 +314,35 @@ void region_rectangles()
         cairo_region_get_rectangle(_region, i, &tmp);
         g_debug("coordiantes: %dx%d, width: %d, height: %d", tmp.x, tmp.y, tmp.width, tmp.height);
     }
+    g_debug("region requests: %u (%u no-op), shape requests: %u (%u skipped)",
+            _stats.requests, _stats.skipped_requests,
+            _stats.shape_requests, _stats.skipped_shapes);
+}
+
+
+PRIVATE
+void _collect_stats(json_object* stats)
+{
+    json_object_object_add(stats, "requests", json_object_new_int(_stats.requests));
+    json_object_object_add(stats, "skipped_requests", json_object_new_int(_stats.skipped_requests));
+    json_object_object_add(stats, "shape_requests", json_object_new_int(_stats.shape_requests));
+    json_object_object_add(stats, "skipped_shapes", json_object_new_int(_stats.skipped_shapes));
+}
+
+
+static void _register_stats() __attribute__((constructor));
+
+void _register_stats()
+{
+    perf_stats_register("dock-region", _collect_stats);
+}
+
+
+static void _unregister_stats() __attribute__((destructor));
+
+void _unregister_stats()
+{
+    perf_stats_unregister("dock-region");
 }
 
 
@@ -31,6 +31,7 @@
 #include <sys/resource.h>
 
 #include <gtk/gtk.h>
+#include <glib/gstdio.h>
 #include <gio/gdesktopappinfo.h>
 
 #include "launcher.h"
@@ -45,6 +46,7 @@
 #include "DBUS_launcher.h"
 #include "common/session_register.h"
 #include "common/display_info.h"
+#include "common/config_store.h"
 
 #include "json-c/json.h"
 
@@ -54,6 +56,8 @@ extern void js_post_signal(const char* signal);
 #define LAUNCHER_CONF "launcher/config.ini"
 #define HIDDEN_APP_GROUP_NAME "HiddenApps"
 #define APPS_INI "launcher/apps.ini"
+// ru_maxrss is in kilobytes
+#define RES_IN_MB(n) ((n) * 1024)
 
 int kill(pid_t, int);  // avoid warning
 
@@ -70,7 +74,6 @@ static GOptionEntry entries[] = {
 };
 
 
-static GKeyFile* launcher_config = NULL;
 PRIVATE GtkWidget* container = NULL;
 PRIVATE GtkWidget* webview = NULL;
 PRIVATE gboolean is_js_already = FALSE;
@@ -237,7 +240,6 @@ JS_EXPORT_API
 void launcher_quit()
 {
     g_debug("#%d# quit", getpid());
-    g_key_file_free(launcher_config);
     gtk_main_quit();
 }
 
@@ -317,21 +319,18 @@ void launcher_webview_ok()
 
 void check_version()
 {
-    if (launcher_config == NULL)
-        launcher_config = load_app_config(LAUNCHER_CONF);
+    GKeyFile* launcher_config = config_store_get(LAUNCHER_CONF);
 
     GError* err = NULL;
     gchar* version = g_key_file_get_string(launcher_config, "main", "version", &err);
     if (err != NULL) {
         g_warning("[%s] read version failed from config file: %s", __func__, err->message);
         g_error_free(err);
-        g_key_file_set_string(launcher_config, "main", "version", LAUNCHER_VERSION);
-        save_app_config(launcher_config, LAUNCHER_CONF);
+        config_store_set_string(LAUNCHER_CONF, "main", "version", LAUNCHER_VERSION);
     }
 
     if (g_strcmp0(LAUNCHER_VERSION, version) != 0) {
-        g_key_file_set_string(launcher_config, "main", "version", LAUNCHER_VERSION);
-        save_app_config(launcher_config, LAUNCHER_CONF);
+        config_store_set_string(LAUNCHER_CONF, "main", "version", LAUNCHER_VERSION);
 
         int noused G_GNUC_UNUSED = system("sed -i 's/__Config__/"HIDDEN_APP_GROUP_NAME"/g' $HOME/.config/"APPS_INI);
     }
@@ -348,9 +347,71 @@ gboolean can_be_restart()
 }
 
 
+PRIVATE
+gboolean _save_snapshot()
+{
+    char* path = category_map_get_snapshot_path();
+    char* dir = g_path_get_dirname(path);
+    g_mkdir_with_parents(dir, 0700);
+    g_free(dir);
+
+    gboolean ok = category_map_save_snapshot(path);
+    g_free(path);
+    return ok;
+}
+
+
+PRIVATE
+gulong _get_status_kb(char const* status, char const* field)
+{
+    char const* line = strstr(status, field);
+    if (line == NULL)
+        return 0;
+    return strtoul(line + strlen(field), NULL, 10);
+}
+
+
+/*
+ * Tell which part of the memory made the launcher restart: the heap
+ * (RssAnon), mapped files such as icons and fonts (RssFile) or shared memory
+ * buffers (RssShmem), along with the state kept on the C side.
+ */
+PRIVATE
+void _report_memory(long max_rss)
+{
+    char* status = NULL;
+    if (!g_file_get_contents("/proc/self/status", &status, NULL, NULL)) {
+        g_message("[%s] max rss: %ldKB", __func__, max_rss);
+        return;
+    }
+
+    struct {
+        char const* name;
+        gulong kb;
+    } parts[] = {
+        { "heap", _get_status_kb(status, "RssAnon:") },
+        { "mapped files", _get_status_kb(status, "RssFile:") },
+        { "shared memory", _get_status_kb(status, "RssShmem:") },
+    };
+    g_free(status);
+
+    guint largest = 0;
+    for (guint i = 1; i < G_N_ELEMENTS(parts); ++i)
+        if (parts[i].kb > parts[largest].kb)
+            largest = i;
+
+    g_message("[%s] max rss: %ldKB, heap: %luKB, mapped files: %luKB, "
+              "shared memory: %luKB, category map: %luKB, mostly %s",
+              __func__, max_rss, parts[0].kb, parts[1].kb, parts[2].kb,
+              (gulong)(category_map_memory_size() / 1024), parts[largest].name);
+}
+
+
 static
 void restart_launcher()
 {
+    if (!_save_snapshot())
+        g_warning("[%s] save snapshot failed, restart from scratch", __func__);
     g_spawn_command_line_async("dde-launcher -rd", NULL);
 }
 
@@ -360,6 +421,7 @@ gboolean _launcher_size_monitor(gpointer user_data G_GNUC_UNUSED)
     struct rusage usg;
     getrusage(RUSAGE_SELF, &usg);
     if (usg.ru_maxrss > RES_IN_MB(180) && can_be_restart()) {
+        _report_memory(usg.ru_maxrss);
         restart_launcher();
         return FALSE;
     }
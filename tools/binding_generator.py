@@ -80,12 +80,22 @@ class Function:
 class CustomFunction(Function):
     pass
 
+# runs on a worker thread and replies when done, see module_c_template.c.
+# The function must be thread safe, native objects must be GObjects.
+class OffloadFunction(Function):
+    def __init__(self, name, ret, *params):
+        Function.__init__(self, name, ret, *params)
+        for param in params:
+            assert isinstance(param, (Boolean, Number, String, NativeObject)), \
+                "%s: %s can't be passed to a worker" % (name, param.__class__.__name__)
+
 class Class:
     def __init__(self, name, desc=None, *args):
         self.name = name
         self.description = desc
         self.properties = args
         self.functions = [ f for f in self.properties if isinstance(f, Function) ]
+        self.has_offload = any(isinstance(f, OffloadFunction) for f in self.functions)
         custom_file_path = os.path.join(
                 os.path.dirname(os.path.realpath(__file__)), name.lower() + '_custom_bindings.py')
         if os.path.exists(custom_file_path):
@@ -93,6 +103,11 @@ class Class:
                 custom_binding = custom_binding_file.read()
                 self.custom_binding = eval(custom_binding)
 
+    def add_stats_functions(self):
+        self.functions.append(Function("get_binding_stats", Object("stats",
+            "function name -> calls, bytes, latency percentiles and histogram in us")))
+        self.functions.append(Function("reset_binding_stats", Null()))
+
     def generate_js_wrapper(self):
         template = env.get_template('module_js_template.js')
         return template.render(module = self)
@@ -105,10 +120,13 @@ class Class:
 env = jinja2.Environment(
         loader=jinja2.FileSystemLoader(os.path.dirname(os.path.realpath(__file__))))
 env.globals['is_custom_function'] = lambda v: isinstance(v, CustomFunction)
+env.globals['is_offload_function'] = lambda v: isinstance(v, OffloadFunction)
+env.globals['is_string'] = lambda v: isinstance(v, String)
 env.globals['is_native_object'] = lambda v: isinstance(v, NativeObject)
 env.globals['is_native_object_array'] = lambda v: isinstance(v, ANativeObject) 
 env.globals['is_null'] = lambda v: isinstance(v, Null)
 env.globals['is_object'] = lambda v: isinstance(v, Object)
+env.globals['stats'] = False
 
 def generate_c_string_for_js(js_file_path, module):
     template = """\
@@ -130,6 +148,8 @@ def generate_bindings(cfg_path, output_dir):
     with open(cfg_path) as f:
         content = f.read()
         module = eval(content)
+        if env.globals['stats']:
+            module.add_stats_functions()
         js_file_path = os.path.join(output_dir, module_name + '_js_api.js')
         c_file_path = os.path.join(output_dir, module_name + '_c_api.c')
         with open(js_file_path, 'w') as js_wrapper:
@@ -139,10 +159,15 @@ def generate_bindings(cfg_path, output_dir):
         generate_c_string_for_js(js_file_path, module)
 
 
-#usage: ./binding_generator.py test.cfg ../output/
+#usage: ./binding_generator.py [--stats] test.cfg ../output/
+# --stats times every binding call, see get_binding_stats in the module.
 if __name__ == "__main__":
-    cfg_file = sys.argv[1]
-    output_dir = sys.argv[2]
+    args = sys.argv[1:]
+    if args[0] == '--stats':
+        env.globals['stats'] = True
+        args = args[1:]
+    cfg_file = args[0]
+    output_dir = args[1]
     print output_dir
     generate_bindings(cfg_file, output_dir)
 
@@ -3,17 +3,26 @@
         "custom_js": """
 //signal_connect custom binding
 var callbacks_ = {};
-extension.setMessageListener(function(msg) {
-  //console.log(msg);
-  var obj = JSON.parse(msg);
+function dispatchSignal_(obj) {
   if (!obj.signal) {
-    console.log('invalid incomming event' + msg);
+    console.log('invalid incomming event' + JSON.stringify(obj));
     return;
   }
   if (obj.signal in callbacks_)
     callbacks_[obj.signal](obj.data);
   else
     console.warn('signal handler not found: ' + obj.signal);
+}
+extension.setMessageListener(function(msg) {
+  //console.log(msg);
+  var obj = JSON.parse(msg);
+  // signals posted in the same main loop iteration come in one batch.
+  if (obj.batch) {
+    for (var i = 0; i < obj.batch.length; ++i)
+      dispatchSignal_(obj.batch[i]);
+    return;
+  }
+  dispatchSignal_(obj);
 });
 
 exports.signal_connect = function(signal, callback) {
@@ -24,19 +33,43 @@ exports.signal_connect = function(signal, callback) {
         "custom_c": """
 //signal_connect custom binding
 extern void dcore_signal_connect(const char* type, JSCallback* value);
+extern void dcore_signal_instance_destroyed(XW_Instance instance);
 void handle_signal_connect(XW_Instance instance, json_object* msg) {
   struct json_object* args;
   json_object_object_get_ex(msg, "args", &args);
   struct json_object* arg_obj_0 = json_object_array_get_idx(args, 0);
   const char* arg_0 = json_object_get_string(arg_obj_0);
 
-  JSCallback* callback = malloc(sizeof(JSCallback));
-  callback->xw_instance = instance;
-  dcore_signal_connect(arg_0, callback);
+  JSCallback callback = { instance };
+  dcore_signal_connect(arg_0, &callback);
+  struct json_object* ret = json_object_new_object();
+  sync_messaging_interface->SetSyncReply(instance, json_object_to_json_string(ret));
+  json_object_put(ret);
+}
+""",
+    },
+    "signal_disconnect": {
+        "custom_js": """
+exports.signal_disconnect = function(signal) {
+  delete callbacks_[signal];
+  sendSyncMessage({ cmd: 'signal_disconnect', args: [signal] });
+};
+""",
+        "custom_c": """
+//signal_disconnect custom binding
+extern void dcore_signal_disconnect(const char* type, JSCallback* value);
+void handle_signal_disconnect(XW_Instance instance, json_object* msg) {
+  struct json_object* args;
+  json_object_object_get_ex(msg, "args", &args);
+  struct json_object* arg_obj_0 = json_object_array_get_idx(args, 0);
+  const char* arg_0 = json_object_get_string(arg_obj_0);
+
+  JSCallback callback = { instance };
+  dcore_signal_disconnect(arg_0, &callback);
   struct json_object* ret = json_object_new_object();
   sync_messaging_interface->SetSyncReply(instance, json_object_to_json_string(ret));
   json_object_put(ret);
 }
 """,
-    }
+    },
 }
@@ -10,6 +10,12 @@
 #include "json-c/json.h"
 
 #include "common/config.h" //FIXME
+{%- if stats %}
+
+#include <string.h>
+#include <signal.h>
+#include <glib-unix.h>
+{%- endif %}
 
 static XW_Extension xw_extension = 0;
 
@@ -47,7 +53,227 @@ json_object* container_to_json_native_object_array(ArrayContainer container) {
   return ret;
 }
 
+{%- if stats %}
+/*
+ * Call stats of every binding, generated with --stats. The latency histogram
+ * is log-linear: one bucket per microsecond for 0-7us, then 4 buckets per
+ * power of two, i.e. 8-9us, 10-11us, 12-13us, 14-15us, 16-19us and so on up
+ * to ~30s. The exported [lower_bound, count] pairs give each bucket's first
+ * microsecond. SIGUSR1 dumps the stats to the log.
+ */
+#define BINDING_HISTOGRAM_BUCKETS 96
+
+typedef struct _BindingStats {
+  const char* name;
+  guint64 calls;
+  guint64 arg_bytes;
+  guint64 reply_bytes;
+  gint64 total_us;
+  gint64 max_us;
+  guint32 histogram[BINDING_HISTOGRAM_BUCKETS];
+} BindingStats;
+
+static BindingStats binding_stats[] = {
+{%- for func in module.functions %}
+  { "{{func.name}}", 0, 0, 0, 0, 0, { 0 } },
+{%- endfor %}
+};
+
+static const XW_Internal_SyncMessagingInterface* real_sync_messaging_interface = NULL;
+static XW_Internal_SyncMessagingInterface counting_sync_messaging_interface;
+static gsize binding_reply_bytes = 0;
+
+static void counting_set_sync_reply(XW_Instance instance, const char* reply) {
+  binding_reply_bytes += strlen(reply);
+  real_sync_messaging_interface->SetSyncReply(instance, reply);
+}
+
+static guint binding_histogram_bucket(gint64 us) {
+  if (us < 4)
+    return us < 0 ? 0 : (guint)us;
+  guint k = g_bit_storage((gulong)us) - 1;
+  guint bucket = (k - 1) * 4 + ((us >> (k - 2)) & 3);
+  return MIN(bucket, BINDING_HISTOGRAM_BUCKETS - 1);
+}
+
+static gint64 binding_bucket_lower_bound(guint bucket) {
+  if (bucket < 4)
+    return bucket;
+  return (gint64)(4 + bucket % 4) << (bucket / 4 - 1);
+}
+
+static gint64 binding_percentile(const BindingStats* s, guint64 permille) {
+  guint64 rank = (s->calls * permille + 999) / 1000;
+  guint64 seen = 0;
+  for (guint i = 0; i < BINDING_HISTOGRAM_BUCKETS; ++i) {
+    seen += s->histogram[i];
+    if (seen >= rank)
+      return binding_bucket_lower_bound(i);
+  }
+  return s->max_us;
+}
+
+static void binding_record_call(guint index, gsize arg_bytes, gsize reply_bytes, gint64 start) {
+  gint64 elapsed = g_get_monotonic_time() - start;
+  BindingStats* s = &binding_stats[index];
+  s->calls++;
+  s->arg_bytes += arg_bytes;
+  s->reply_bytes += reply_bytes;
+  s->total_us += elapsed;
+  if (elapsed > s->max_us)
+    s->max_us = elapsed;
+  s->histogram[binding_histogram_bucket(elapsed)]++;
+}
+
+#define BINDING_CALL(index, call) do { \
+  gint64 start = g_get_monotonic_time(); \
+  binding_reply_bytes = 0; \
+  call; \
+  binding_record_call(index, strlen(msg), binding_reply_bytes, start); \
+} while (0)
+
+// the message size of the offloaded call being dispatched, recorded on reply.
+static gsize binding_offload_arg_bytes = 0;
+
+json_object* {{module.name.lower()}}_get_binding_stats() {
+  json_object* stats = json_object_new_object();
+  for (guint i = 0; i < G_N_ELEMENTS(binding_stats); ++i) {
+    const BindingStats* s = &binding_stats[i];
+    if (s->calls == 0)
+      continue;
+
+    json_object* histogram = json_object_new_array();
+    for (guint j = 0; j < BINDING_HISTOGRAM_BUCKETS; ++j) {
+      if (s->histogram[j] == 0)
+        continue;
+      json_object* bucket = json_object_new_array();
+      json_object_array_add(bucket, json_object_new_int64(binding_bucket_lower_bound(j)));
+      json_object_array_add(bucket, json_object_new_int64(s->histogram[j]));
+      json_object_array_add(histogram, bucket);
+    }
+
+    json_object* func = json_object_new_object();
+    json_object_object_add(func, "calls", json_object_new_int64(s->calls));
+    json_object_object_add(func, "arg_bytes", json_object_new_int64(s->arg_bytes));
+    json_object_object_add(func, "reply_bytes", json_object_new_int64(s->reply_bytes));
+    json_object_object_add(func, "total_us", json_object_new_int64(s->total_us));
+    json_object_object_add(func, "max_us", json_object_new_int64(s->max_us));
+    json_object_object_add(func, "p50_us", json_object_new_int64(binding_percentile(s, 500)));
+    json_object_object_add(func, "p90_us", json_object_new_int64(binding_percentile(s, 900)));
+    json_object_object_add(func, "p99_us", json_object_new_int64(binding_percentile(s, 990)));
+    json_object_object_add(func, "histogram", histogram);
+    json_object_object_add(stats, s->name, func);
+  }
+  return stats;
+}
+
+void {{module.name.lower()}}_reset_binding_stats() {
+  for (guint i = 0; i < G_N_ELEMENTS(binding_stats); ++i) {
+    const char* name = binding_stats[i].name;
+    memset(&binding_stats[i], 0, sizeof(BindingStats));
+    binding_stats[i].name = name;
+  }
+}
+
+static gboolean binding_dump_stats(gpointer user_data) {
+  (void)user_data;
+  for (guint i = 0; i < G_N_ELEMENTS(binding_stats); ++i) {
+    const BindingStats* s = &binding_stats[i];
+    if (s->calls == 0)
+      continue;
+    g_message("[{{module.name}}] %s: %" G_GUINT64_FORMAT " calls, avg %" G_GINT64_FORMAT
+              "us, p50 %" G_GINT64_FORMAT "us, p99 %" G_GINT64_FORMAT "us, max %" G_GINT64_FORMAT
+              "us, %" G_GUINT64_FORMAT "/%" G_GUINT64_FORMAT " bytes in/out",
+              s->name, s->calls, s->total_us / (gint64)s->calls,
+              binding_percentile(s, 500), binding_percentile(s, 990), s->max_us,
+              s->arg_bytes, s->reply_bytes);
+  }
+  return TRUE;
+}
+{% endif %}
+{%- macro parse_args(func) %}
+  {%- if func.params|count %}
+  struct json_object* args; 
+  json_object_object_get_ex(msg, "args", &args);
+  {%- endif -%}
+  {%- for param in func.params %}
+  struct json_object* arg_obj_{{loop.index0}} = json_object_array_get_idx(args, {{loop.index0}});
+    {%- if is_native_object_array(param) %}
+  ArrayContainer arg_{{loop.index0}} = json_native_object_array_to_container(arg_obj_{{loop.index0}});
+    {%- elif is_native_object(param) %}
+  void* arg_{{loop.index0}} = (void*)json_object_get_int64(arg_obj_{{loop.index0}});
+    {%- else %}
+  {{param.c_type}} arg_{{loop.index0}} = json_object_get_{{param.json_type}}(arg_obj_{{loop.index0}});
+    {%- endif -%}
+  {%- endfor %}
+{%- endmacro %}
+
+{%- macro build_reply(func) %}
+  struct json_object* ret = json_object_new_object();
+  {%- if is_object(func.ret) %}
+  json_object_object_add(ret, "data", data);
+  {%- elif is_native_object(func.ret) %}
+  json_object_object_add(ret, "data", json_object_new_int64((int64_t)data));
+  {%- elif is_native_object_array(func.ret) %}
+  json_object_object_add(ret, "data", container_to_json_native_object_array(data));
+  {%- elif is_null(func.ret) %}
+  json_object_object_add(ret, "data", json_object_new_object());
+  {%- else %}
+  json_object_object_add(ret, "data", json_object_new_{{func.ret.json_type}}(data));
+  {%- endif %}
+{%- endmacro %}
+
+{%- if module.has_offload %}
+/*
+ * Offloaded functions run on a worker pool, the reply is set from the main
+ * loop once they finish, so X events, inotify and DBus keep being processed
+ * meanwhile. The JS side still blocks on the sync message as before.
+ */
+#define OFFLOAD_MAX_THREADS 4
+
+typedef struct _OffloadCall {
+  XW_Instance instance;
+  void (*run)(struct _OffloadCall* call); // fills reply, frees the arguments
+  char* reply;
+  {%- if stats %}
+  guint stats_index;
+  gsize arg_bytes;
+  gint64 start;
+  {%- endif %}
+} OffloadCall;
+
+static GThreadPool* offload_pool = NULL;
+
+static gboolean offload_reply(gpointer user_data) {
+  OffloadCall* call = user_data;
+  {%- if stats %}
+  // timed from dispatch to reply, not through counting_set_sync_reply.
+  real_sync_messaging_interface->SetSyncReply(call->instance, call->reply);
+  binding_record_call(call->stats_index, call->arg_bytes, strlen(call->reply), call->start);
+  {%- else %}
+  sync_messaging_interface->SetSyncReply(call->instance, call->reply);
+  {%- endif %}
+  g_free(call->reply);
+  g_free(call);
+  return FALSE;
+}
+
+static void offload_run(gpointer data, gpointer user_data) {
+  (void)user_data;
+  OffloadCall* call = data;
+  call->run(call);
+  // always reply from the main loop, never from the worker.
+  g_idle_add_full(G_PRIORITY_DEFAULT, offload_reply, call, NULL);
+}
+
+static void offload_call(OffloadCall* call) {
+  if (offload_pool == NULL)
+    offload_pool = g_thread_pool_new(offload_run, NULL, OFFLOAD_MAX_THREADS, FALSE, NULL);
+  g_thread_pool_push(offload_pool, call, NULL);
+}
+{% endif %}
 {% for func in module.functions %}
+{%- set func_index = loop.index0 %}
 {%- if is_custom_function(func) %}
 {{module.custom_binding[func.name]['custom_c']}}
 {% else %}
@@ -60,21 +286,66 @@ extern {{func.ret.c_type}} {{module.name.lower()}}_{{func.name}}(
     {%- endif -%}
   {%- endfor -%}
 );
+{%- if is_offload_function(func) %}
+typedef struct _{{func.name}}_call {
+  OffloadCall base;
+  {%- for param in func.params %}
+  {{param.c_type}} arg_{{loop.index0}};
+  {%- endfor %}
+} {{func.name}}_call;
+
+static void run_{{func.name}}(OffloadCall* base) {
+  {{func.name}}_call* call = ({{func.name}}_call*)base;
+  {% if is_null(func.ret) -%}
+  {%- else -%}
+  {{func.ret.c_type}} data = {% endif -%}
+  {{module.name.lower()}}_{{func.name}}(
+      {%- for i in range(func.params|count) -%}
+        {%- if i == func.params|count - 1 -%}
+      call->arg_{{i}}
+        {%- else -%}
+      call->arg_{{i}},
+        {%- endif -%}
+      {%- endfor -%});
+  {{- build_reply(func) }}
+  base->reply = g_strdup(json_object_to_json_string(ret));
+  json_object_put(ret);
+  {%- for param in func.params %}
+    {%- if is_native_object(param) %}
+  if (call->arg_{{loop.index0}} != NULL)
+    g_object_unref(call->arg_{{loop.index0}});
+    {%- elif is_string(param) %}
+  g_free((char*)call->arg_{{loop.index0}});
+    {%- endif %}
+  {%- endfor %}
+}
+
 void handle_{{func.name}}(XW_Instance instance, json_object* msg) {
-  {% if func.params|count -%}
-  struct json_object* args; 
-  json_object_object_get_ex(msg, "args", &args);
-  {%- endif -%}
+  {{- parse_args(func) }}
+
+  {{func.name}}_call* call = g_new0({{func.name}}_call, 1);
+  call->base.instance = instance;
+  call->base.run = run_{{func.name}};
+  {%- if stats %}
+  call->base.stats_index = {{func_index}};
+  call->base.arg_bytes = binding_offload_arg_bytes;
+  call->base.start = g_get_monotonic_time();
+  {%- endif %}
   {%- for param in func.params %}
-  struct json_object* arg_obj_{{loop.index0}} = json_object_array_get_idx(args, {{loop.index0}});
-    {%- if is_native_object_array(param) %}
-  ArrayContainer arg_{{loop.index0}} = json_native_object_array_to_container(arg_obj_{{loop.index0}});
-    {%- elif is_native_object(param) %}
-  void* arg_{{loop.index0}} = (void*)json_object_get_int64(arg_obj_{{loop.index0}});
+    {%- if is_native_object(param) %}
+  // keep the object alive even if JS releases it before the worker is done.
+  call->arg_{{loop.index0}} = arg_{{loop.index0}} != NULL ? g_object_ref(arg_{{loop.index0}}) : NULL;
+    {%- elif is_string(param) %}
+  call->arg_{{loop.index0}} = g_strdup(arg_{{loop.index0}});
     {%- else %}
-  {{param.c_type}} arg_{{loop.index0}} = json_object_get_{{param.json_type}}(arg_obj_{{loop.index0}});
-    {%- endif -%}
+  call->arg_{{loop.index0}} = arg_{{loop.index0}};
+    {%- endif %}
   {%- endfor %}
+  offload_call(&call->base);
+}
+{%- else %}
+void handle_{{func.name}}(XW_Instance instance, json_object* msg) {
+  {{- parse_args(func) }}
 
   {% if is_null(func.ret) -%}
   {%- else -%}
@@ -87,21 +358,11 @@ void handle_{{func.name}}(XW_Instance instance, json_object* msg) {
       arg_{{i}},
         {%- endif -%}
       {%- endfor -%});
-  struct json_object* ret = json_object_new_object();
-  {%- if is_object(func.ret) %}
-  json_object_object_add(ret, "data", data);
-  {%- elif is_native_object(func.ret) %}
-  json_object_object_add(ret, "data", json_object_new_int64((int64_t)data));
-  {%- elif is_native_object_array(func.ret) %}
-  json_object_object_add(ret, "data", container_to_json_native_object_array(data));
-  {%- elif is_null(func.ret) %}
-  json_object_object_add(ret, "data", json_object_new_object());
-  {%- else %}
-  json_object_object_add(ret, "data", json_object_new_{{func.ret.json_type}}(data));
-  {%- endif %}
+  {{- build_reply(func) }}
   sync_messaging_interface->SetSyncReply(instance, json_object_to_json_string(ret));
   json_object_put(ret);
 }
+{%- endif %}
 {% endif -%}
 {% endfor %}
 
@@ -119,7 +380,16 @@ void handle_sync_message(XW_Instance instance, const char* msg) {
     {%- else %}
   else if (!strcmp(cmd, "{{func.name}}"))
     {%- endif %}
+    {%- if stats and is_offload_function(func) %}
+  {
+    binding_offload_arg_bytes = strlen(msg);
+    handle_{{func.name}}(instance, obj);
+  }
+    {%- elif stats %}
+    BINDING_CALL({{loop.index0}}, handle_{{func.name}}(instance, obj));
+    {%- else %}
     handle_{{func.name}}(instance, obj);
+    {%- endif %}
   {%- endfor %}
   else
     fprintf(stderr, "ASSERT NOT REACHED.\n");
@@ -127,11 +397,21 @@ void handle_sync_message(XW_Instance instance, const char* msg) {
   json_object_put(obj);
 }
 
+{% if module.name == "DCore" -%}
+extern void perf_stats_dump();
+static void dcore_shutdown(XW_Extension extension) {
+  (void)extension;
+  perf_stats_dump();
+}
+
+{% endif -%}
 int32_t XW_Initialize(XW_Extension extension, XW_GetInterface get_interface) {
   xw_extension = extension;
   core_interface = get_interface(XW_CORE_INTERFACE);
   {%- if module.name == "DCore" %}
   core_interface->SetExtensionName(extension, "DCore");
+  core_interface->RegisterInstanceCallbacks(extension, NULL, dcore_signal_instance_destroyed);
+  core_interface->RegisterShutdownCallback(extension, dcore_shutdown);
   {% else %}
   core_interface->SetExtensionName(extension, "DCore.{{module.name}}");
   {% endif -%}
@@ -139,6 +419,14 @@ int32_t XW_Initialize(XW_Extension extension, XW_GetInterface get_interface) {
 
   async_messaging_interface = get_interface(XW_MESSAGING_INTERFACE);
   sync_messaging_interface = get_interface(XW_INTERNAL_SYNC_MESSAGING_INTERFACE);
+  {%- if stats %}
+  // count the reply bytes of every handler, custom ones included.
+  real_sync_messaging_interface = sync_messaging_interface;
+  counting_sync_messaging_interface = *sync_messaging_interface;
+  counting_sync_messaging_interface.SetSyncReply = counting_set_sync_reply;
+  sync_messaging_interface = &counting_sync_messaging_interface;
+  g_unix_signal_add(SIGUSR1, binding_dump_stats, NULL);
+  {%- endif %}
   sync_messaging_interface->Register(extension, handle_sync_message);
 
   return XW_OK;